@@ -94,12 +94,100 @@
 #define SQL_DEFAULT_INIT_CONNECTIONS 5
 
 
+/**
+ * Upper bound on the number of idle-connection shards in a ConnectionPool.
+ * The actual number is the number of online CPUs, capped by this value
+ */
+#define SQL_MAX_POOL_SHARDS 16
+
+
+/**
+ * Maximum number of threads used to open or close Connections in parallel
+ * when a ConnectionPool is started or stopped
+ */
+#define SQL_MAX_CONNECT_THREADS 8
+
+
 /**
  * The standard sweep interval in seconds for a ConnectionPool reaper thread
  */
 #define SQL_DEFAULT_SWEEP_INTERVAL 60
 
 
+/**
+ * Mean check-out wait in microseconds above which the adaptive pool 
+ * controller considers the pool too small
+ */
+#define SQL_ADAPTIVE_MAX_WAIT 1000
+
+
+/**
+ * Maximum number of idle Connections the reaper examines per sweep
+ */
+#define SQL_MAX_REAP_BATCH 32
+
+
+/**
+ * Default maximum replication lag in milliseconds before a read replica 
+ * is no longer used
+ */
+#define SQL_DEFAULT_MAX_REPLICATION_LAG 10000
+
+
+/**
+ * Milliseconds a host in a multi-host URL is ejected after the first failed
+ * connect. The period doubles with each consecutive failure
+ */
+#define SQL_HOST_BACKOFF 1000
+
+
+/**
+ * Maximum milliseconds a host in a multi-host URL is ejected
+ */
+#define SQL_HOST_MAX_BACKOFF 60000
+
+
+/**
+ * A host in a multi-host URL with latency above this factor times the 
+ * fastest host's latency is considered a slow outlier
+ */
+#define SQL_HOST_OUTLIER_FACTOR 3
+
+
+/**
+ * Latency in microseconds below which a host is never considered a slow 
+ * outlier
+ */
+#define SQL_HOST_OUTLIER_LATENCY 1000
+
+
+/**
+ * Default maximum size in bytes of the SQL text of the statements in a 
+ * Connection's statement cache
+ */
+#define SQL_DEFAULT_STATEMENT_CACHE_MEMORY 1048576
+
+
+/**
+ * Default number of consecutive failed connects which open a 
+ * ConnectionPool's circuit breaker
+ */
+#define SQL_BREAKER_FAILURES 5
+
+
+/**
+ * Milliseconds the circuit breaker stays open after the first trip. The 
+ * period doubles with each consecutive trip
+ */
+#define SQL_BREAKER_BACKOFF 1000
+
+
+/**
+ * Default maximum milliseconds the circuit breaker stays open
+ */
+#define SQL_BREAKER_MAX_BACKOFF 30000
+
+
 /**
  * Default Connection timeout in seconds, used by reaper to remove
  * inactive connections
@@ -113,6 +201,35 @@
 #define SQL_DEFAULT_PREFETCH_ROWS 100
 
 
+/**
+ * Maximum number of statements sent in a PostgreSQL pipeline before the
+ * results are read, so neither side blocks on a full socket buffer
+ */
+#define SQL_PIPELINE_DEPTH 1000
+
+
+/**
+ * Maximum number of rows a BulkLoader buffers before they are sent to
+ * the database
+ */
+#define SQL_BULK_LOAD_ROWS 10000
+
+
+/**
+ * Maximum size in bytes of the string and blob values a BulkLoader buffers
+ * before the rows are sent to the database
+ */
+#define SQL_BULK_LOAD_SIZE 4194304
+
+
+/**
+ * Maximum size in bytes of the buffer a MySQL ResultSet allocates up front
+ * for a string or blob column. A larger value grows the buffer when read.
+ * Can be set per connection with the column-buffer URL parameter
+ */
+#define SQL_MYSQL_COLUMN_BUFFER 16384
+
+
 /**
  * MySQL default server port number
  */
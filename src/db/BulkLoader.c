@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "URL.h"
+#include "ResultSet.h"
+#include "PreparedStatement.h"
+#include "BulkLoader.h"
+#include "Connection.h"
+
+
+/**
+ * Implementation of the BulkLoader interface 
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- Definitions */
+
+
+#define T BulkLoader_T
+struct BulkLoader_S {
+        Lop_T op;
+        int capacity;
+        bool finished;
+        long size; // Bytes of string and blob values buffered
+        long long rows;
+        BatchValue_T row; // Values of the current row, by reference
+        struct Batch_T batch; // Rows buffered for the delegate
+        PreparedStatement_T statement; // Used if the database has no native bulk load
+        Connection_T transaction; // Committed by BulkLoader_finish()
+        BulkLoaderDelegate_T D;
+};
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static T _new(int columns) {
+        T L;
+        NEW(L);
+        L->batch.columns = columns;
+        if (columns > 0)
+                L->row = CALLOC(columns, sizeof(struct BatchValue_T));
+        return L;
+}
+
+
+static void _clearBatch(T L) {
+        // With a statement, rows are buffered in the statement's batch and only counted here
+        for (int i = 0; ! L->statement && i < L->batch.rows * L->batch.columns; i++) {
+                BatchValue_T v = &L->batch.values[i];
+                if (v->type == Batch_string || v->type == Batch_blob)
+                        FREE(v->v.p);
+        }
+        L->batch.rows = 0;
+        L->size = 0;
+}
+
+
+static BatchValue_T _column(T L, int columnIndex) {
+        if (L->finished)
+                THROW(SQLException, "Bulk load is finished");
+        if (columnIndex < 1 || columnIndex > L->batch.columns)
+                THROW(SQLException, "Column index is out of range");
+        return &L->row[columnIndex - 1];
+}
+
+
+/* Send buffered rows to the database. The BulkLoader cannot be used after an error */
+static void _flush(T L) {
+        TRY
+        {
+                if (L->statement) {
+                        PreparedStatement_executeBatch(L->statement);
+                } else if (L->batch.rows > 0) {
+                        L->op->load(L->D, &L->batch);
+                }
+        }
+        ELSE
+        {
+                L->finished = true;
+                RETHROW;
+        }
+        FINALLY
+        {
+                _clearBatch(L);
+        }
+        END_TRY;
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+T BulkLoader_new(BulkLoaderDelegate_T D, Lop_T op, int columns) {
+        assert(D);
+        assert(op);
+        T L = _new(columns);
+        L->D = D;
+        L->op = op;
+        return L;
+}
+
+
+T BulkLoader_newWithStatement(PreparedStatement_T p) {
+        assert(p);
+        T L = _new(PreparedStatement_getParameterCount(p));
+        L->statement = p;
+        return L;
+}
+
+
+void BulkLoader_setTransaction(T L, Connection_T C) {
+        assert(L);
+        L->transaction = C;
+}
+
+
+void BulkLoader_free(T *L) {
+        assert(L && *L);
+        _clearBatch((*L));
+        if ((*L)->op)
+                (*L)->op->free(&(*L)->D);
+        if ((*L)->statement)
+                PreparedStatement_free(&(*L)->statement);
+        FREE((*L)->batch.values);
+        FREE((*L)->row);
+        FREE(*L);
+}
+
+
+/* --------------------------------------------------------------- Columns */
+
+
+void BulkLoader_setString(T L, int columnIndex, const char *x) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = x ? Batch_string : Batch_null;
+        v->v.p = (void *)x;
+}
+
+
+void BulkLoader_setInt32(T L, int columnIndex, int32_t x) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = Batch_int;
+        v->v.i = x;
+}
+
+
+void BulkLoader_setInt64(T L, int columnIndex, int64_t x) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = Batch_int;
+        v->v.i = x;
+}
+
+
+void BulkLoader_setDouble(T L, int columnIndex, double x) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = Batch_double;
+        v->v.d = x;
+}
+
+
+void BulkLoader_setBlob(T L, int columnIndex, const void *x, int size) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = x ? Batch_blob : Batch_null;
+        v->size = x ? size : 0;
+        v->v.p = (void *)x;
+}
+
+
+void BulkLoader_setTimestamp(T L, int columnIndex, time_t x) {
+        assert(L);
+        BatchValue_T v = _column(L, columnIndex);
+        v->type = Batch_timestamp;
+        v->v.t = x;
+}
+
+
+/* -------------------------------------------------------- Public methods */
+
+
+void BulkLoader_appendRow(T L) {
+        assert(L);
+        if (L->finished)
+                THROW(SQLException, "Bulk load is finished");
+        if (L->statement) {
+                for (int i = 0; i < L->batch.columns; i++) {
+                        BatchValue_T v = &L->row[i];
+                        switch (v->type) {
+                                case Batch_string:    PreparedStatement_setString(L->statement, i + 1, v->v.p); L->size += strlen(v->v.p); break;
+                                case Batch_int:       PreparedStatement_setInt64(L->statement, i + 1, v->v.i); break;
+                                case Batch_double:    PreparedStatement_setDouble(L->statement, i + 1, v->v.d); break;
+                                case Batch_timestamp: PreparedStatement_setTimestamp(L->statement, i + 1, v->v.t); break;
+                                case Batch_blob:      PreparedStatement_setBlob(L->statement, i + 1, v->v.p, v->size); L->size += v->size; break;
+                                default:              PreparedStatement_setString(L->statement, i + 1, NULL); break;
+                        }
+                }
+                PreparedStatement_addBatch(L->statement);
+                L->batch.rows++;
+        } else {
+                if (L->batch.rows == L->capacity) {
+                        L->capacity = L->capacity ? L->capacity * 2 : 16;
+                        if (L->batch.columns > 0) {
+                                long size = (long)L->capacity * L->batch.columns * sizeof(struct BatchValue_T);
+                                if (L->batch.values)
+                                        RESIZE(L->batch.values, size);
+                                else
+                                        L->batch.values = ALLOC(size);
+                        }
+                }
+                // String and blob values are copied, the row's values are only references
+                for (int i = 0; i < L->batch.columns; i++) {
+                        BatchValue_T v = batchValue(&L->batch, L->batch.rows, i);
+                        *v = L->row[i];
+                        if (v->type == Batch_string) {
+                                v->size = (int)strlen(v->v.p);
+                                v->v.p = Str_ndup(v->v.p, v->size);
+                                L->size += v->size;
+                        } else if (v->type == Batch_blob) {
+                                void *copy = ALLOC(v->size + 1);
+                                memcpy(copy, v->v.p, v->size);
+                                v->v.p = copy;
+                                L->size += v->size;
+                        }
+                }
+                L->batch.rows++;
+        }
+        L->rows++;
+        if (L->batch.columns > 0)
+                memset(L->row, 0, L->batch.columns * sizeof(struct BatchValue_T));
+        if (L->batch.rows >= SQL_BULK_LOAD_ROWS || L->size >= SQL_BULK_LOAD_SIZE)
+                _flush(L);
+}
+
+
+long long BulkLoader_finish(T L) {
+        assert(L);
+        if (L->finished)
+                THROW(SQLException, "Bulk load is finished");
+        _flush(L);
+        L->finished = true;
+        if (L->op)
+                L->op->finish(L->D);
+        if (L->transaction) {
+                Connection_T C = L->transaction;
+                L->transaction = NULL;
+                Connection_commit(C);
+        }
+        return L->rows;
+}
+
+
+long long BulkLoader_getRows(T L) {
+        assert(L);
+        return L->rows;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#ifndef BULKLOADER_INCLUDED
+#define BULKLOADER_INCLUDED
+#include <time.h>
+//<< Protected methods
+#include "PreparedStatementDelegate.h"
+#include "BulkLoaderDelegate.h"
+struct Connection_S;
+//>> End Protected methods
+
+
+/**
+ * A <b>BulkLoader</b> loads rows into a table using the fastest method the
+ * database provides. A BulkLoader is created by calling 
+ * Connection_bulkLoad() with the table and a comma separated list of
+ * its columns. Each row is built with the setter methods defined in this
+ * interface and added with BulkLoader_appendRow(). The first column has 
+ * index 1, the next has index 2 and so on. Columns not set for a row are
+ * NULL. BulkLoader_finish() completes the load.
+ *
+ * Rows are buffered in memory and sent to the database in chunks, so 
+ * no temporary files are used:
+ * <ul>
+ * <li><i class="textinfo">PostgreSQL</i> streams rows with COPY FROM STDIN</li>
+ * <li><i class="textinfo">MySQL</i> sends each chunk with LOAD DATA LOCAL 
+ * INFILE, read from memory. The server must allow local_infile</li>
+ * <li><i class="textinfo">Oracle</i> and <i class="textinfo">SQLite</i>
+ * insert the rows with a prepared INSERT executed as a batch, see 
+ * PreparedStatement_executeBatch()</li>
+ * </ul>
+ * If the Connection is not in a transaction, Connection_bulkLoad() begins
+ * one and BulkLoader_finish() commits it, so the load is all or nothing. If
+ * loading fails, an SQLException is thrown, the BulkLoader can no longer
+ * be used and the transaction is rolled back when the Connection is closed
+ * or by calling Connection_rollback().
+ *
+ * <h2 class="desc">Example:</h2>
+ * <pre>
+ * BulkLoader_T l = Connection_bulkLoad(con, "employee", "name, salary, photo");
+ * for (int i = 0; employees[i]; i++)
+ * {
+ *        BulkLoader_setString(l, 1, employees[i].name);
+ *        BulkLoader_setDouble(l, 2, employees[i].salary);
+ *        BulkLoader_setBlob(l, 3, employees[i].photo, employees[i].photo_size);
+ *        BulkLoader_appendRow(l);
+ * }
+ * long long rows = BulkLoader_finish(l);
+ * </pre>
+ *
+ * String and blob values are set by reference and <b>must</b> not 
+ * "disappear" before BulkLoader_appendRow() is called, which copies them.
+ * A BulkLoader "lives" until the next call to Connection_bulkLoad() or
+ * until the Connection is returned to the Connection Pool. Other 
+ * statements should not be executed on the Connection before the load is
+ * finished.
+ *
+ * <i>A BulkLoader is reentrant, but not thread-safe and should only be used by one thread (at the time).</i>
+ *
+ * @see Connection.h PreparedStatement.h SQLException.h
+ * @file
+ */
+
+
+#define T BulkLoader_T
+typedef struct BulkLoader_S *T;
+
+//<< Protected methods
+
+/**
+ * Create a new BulkLoader using a database's native bulk load method.
+ * @param D the delegate used by this BulkLoader
+ * @param op delegate operations
+ * @param columns The number of columns in a row
+ * @return A new BulkLoader object
+ */
+T BulkLoader_new(BulkLoaderDelegate_T D, Lop_T op, int columns) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Create a new BulkLoader which inserts rows by executing a batch of the
+ * single-row INSERT statement p
+ * @param p A PreparedStatement with one parameter per column. The 
+ * BulkLoader takes ownership of the statement
+ * @return A new BulkLoader object
+ */
+T BulkLoader_newWithStatement(PreparedStatement_T p) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Commit the transaction on Connection C when the load is finished 
+ * @param L A BulkLoader object
+ * @param C The Connection which began a transaction for the load
+ */
+void BulkLoader_setTransaction(T L, struct Connection_S *C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Destroy a BulkLoader and release allocated resources. A load which was
+ * not finished is aborted.
+ * @param L A BulkLoader object reference
+ */
+void BulkLoader_free(T *L) __attribute__ ((visibility("hidden")));
+
+//>> End Protected methods
+
+/** @name Columns */
+//@{
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given string value.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The string value to set. Must be a NUL terminated string. NULL
+ * is allowed to indicate a SQL NULL value.
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h
+ */
+void BulkLoader_setString(T L, int columnIndex, const char *x);
+
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given int value.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The int value to set
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h
+ */
+void BulkLoader_setInt32(T L, int columnIndex, int32_t x);
+
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given 64-bit int value.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The 64-bit int value to set
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h
+ */
+void BulkLoader_setInt64(T L, int columnIndex, int64_t x);
+
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given double value.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The double value to set
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h
+ */
+void BulkLoader_setDouble(T L, int columnIndex, double x);
+
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given blob value.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The blob value to set
+ * @param size The number of bytes in the blob
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h
+ */
+void BulkLoader_setBlob(T L, int columnIndex, const void *x, int size);
+
+
+/**
+ * Sets the column at index <code>columnIndex</code> of the current row to
+ * the given Unix timestamp value, expected to be in the GMT timezone.
+ * @param L A BulkLoader object
+ * @param columnIndex The first column is 1, the second is 2,..
+ * @param x The GMT timestamp value to set. E.g. a value returned by time(3)
+ * @exception SQLException If the column index is out of range or if the
+ * load is finished
+ * @see SQLException.h PreparedStatement_setTimestamp
+ */
+void BulkLoader_setTimestamp(T L, int columnIndex, time_t x);
+
+//@}
+
+/**
+ * Append the current row to the load and start a new row with all 
+ * columns NULL. Rows are sent to the database when enough are buffered.
+ * @param L A BulkLoader object
+ * @exception SQLException If a database error occurs or if the load is
+ * finished
+ * @see SQLException.h
+ */
+void BulkLoader_appendRow(T L);
+
+
+/**
+ * Send the remaining rows and complete the load. If 
+ * Connection_bulkLoad() began a transaction, it is committed.
+ * @param L A BulkLoader object
+ * @return The number of rows loaded
+ * @exception SQLException If a database error occurs or if the load is
+ * already finished
+ * @see SQLException.h
+ */
+long long BulkLoader_finish(T L);
+
+
+/**
+ * Returns the number of rows appended so far
+ * @param L A BulkLoader object
+ * @return The number of rows appended with BulkLoader_appendRow()
+ */
+long long BulkLoader_getRows(T L);
+
+
+#undef T
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#ifndef BULKLOADERDELEGATE_INCLUDED
+#define BULKLOADERDELEGATE_INCLUDED
+
+/**
+ * This interface defines the <b>contract</b> for the concrete database
+ * implementation used for delegation in the BulkLoader class. Rows are
+ * buffered by the BulkLoader and handed to the delegate's load method 
+ * in chunks, using the Batch_T value layout of PreparedStatementDelegate.h
+ *
+ * @file
+ */
+
+#define T BulkLoaderDelegate_T
+typedef struct T *T;
+
+typedef struct Lop_T {
+        const char *name;
+        // Abort the load if it was not finished
+        void (*free)(T *L);
+        // Send rows to the database, throws SQLException on error
+        void (*load)(T L, Batch_T rows);
+        // Complete the load, throws SQLException on error
+        void (*finish)(T L);
+} *Lop_T;
+
+#undef T
+#endif
@@ -28,12 +28,19 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_STDATOMIC_H
+#include <stdatomic.h>
+#else
+#define _Atomic(x) volatile x
+#endif
 
 #include "URL.h"
 #include "Vector.h"
 #include "system/Time.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
+#include "BulkLoader.h"
 #include "Connection.h"
 #include "ConnectionPool.h"
 #include "ConnectionDelegate.h"
@@ -78,21 +85,48 @@ static const struct Cop_T *cops[] = {
         NULL
 };
 
+/* 
+ * Statement cache entry keyed by the SQL text. Statements prepared when the
+ * Connection was opened, see ConnectionPool_addPreparedStatement(), are 
+ * pinned and never evicted. Other statements are evicted least recently 
+ * used first, but not while they may be in use in the current check-out
+ */
+typedef struct statement_t {
+        char *sql;
+        uint32_t hash;
+        bool pinned;
+        long long lastUsed;
+        PreparedStatement_T p; // NULL if invalidated by a reconnect
+} *statement_t;
 #define T Connection_T
 struct Connection_S {
         Cop_T op;
         URL_T url;
+        int host;
         int maxRows;
-        int fetchSize;
+        int fetchSize; // 0 if not set, SQL_DEFAULT_PREFETCH_ROWS is used
         bool isAvailable;
         int queryTimeout;
         Vector_T prepared;
+        Vector_T statements;
+        int cached; // Unpinned statements in the cache
+        long cacheMemory; // SQL text size of unpinned statements
+        long long tick; // Statement cache clock
+        long long checkedOut; // Statement cache clock at check-out
+        long long session; // Server session the statements were prepared in
         int isInTransaction;
+        bool pipeline;
         int fetchSizeDefault;
-        time_t lastAccessedTime;
+        long long lastAccessedTime;
         ResultSet_T resultSet;
+        BulkLoader_T loader;
         ConnectionDelegate_T D;
         ConnectionPool_T parent;
+        char *position;
+        const char *tag;
+        bool leaked;
+        int priority;
+        _Atomic(int) held; // 1 while checked out, see Connection_release()
 };
 
 
@@ -118,11 +152,209 @@ static bool _setDelegate(T C, char **error) {
 }
 
 
+/* Open the delegate to a host chosen by the pool. With a multi-host URL, a
+ host which fails is reported to the pool and the next host is tried */
+static bool _connect(T C, char **error) {
+        int hosts = URL_getHostCount(C->url);
+        for (int i = 0; i < hosts || i == 0; i++) {
+                C->host = ConnectionPool_selectHost(C->parent);
+                long long start = Time_micro();
+                if (_setDelegate(C, error)) {
+                        ConnectionPool_reportHost(C->parent, C->host, Time_micro() - start, true);
+                        C->session = C->op->sessionId ? C->op->sessionId(C->D) : 0;
+                        return true;
+                }
+                if (! C->op)
+                        break;
+                ConnectionPool_reportHost(C->parent, C->host, 0, false);
+                if (i < hosts - 1) {
+                        DEBUG("Failed to connect to %s -- %s\n", Connection_getHost(C), *error);
+                        FREE(*error);
+                }
+        }
+        return false;
+}
+
+
+/* Run the pool's initialization of a new Connection */
+static bool _init(T C, char **error) {
+        volatile bool ok = true;
+        TRY
+        {
+                ConnectionPool_initConnection(C->parent, C);
+        }
+        ELSE
+        {
+                *error = Str_cat("failed to initialize connection -- %s", Exception_frame.message);
+                ok = false;
+        }
+        END_TRY;
+        return ok;
+}
+
+
+static PreparedStatement_T _prepare(T C, const char *sql, ...) {
+        va_list ap;
+        va_start(ap, sql);
+        PreparedStatement_T p = C->op->prepareStatement(C->D, sql, ap);
+        va_end(ap);
+        return p;
+}
+
+
+/* Number of columns in a comma separated list, commas in quoted names excepted */
+static int _columnCount(const char *columns) {
+        int count = 1;
+        char quote = 0;
+        for (const char *s = columns; *s; s++) {
+                if (quote) {
+                        if (*s == quote)
+                                quote = 0;
+                } else if (*s == '"' || *s == '`') {
+                        quote = *s;
+                } else if (*s == ',') {
+                        count++;
+                }
+        }
+        return count;
+}
+
+
+/* Close the result set, bulk loader and pipeline, if any */
+static void _closeResults(T C) {
+        if (C->resultSet)
+                ResultSet_free(&C->resultSet);
+        if (C->loader)
+                BulkLoader_free(&C->loader);
+        if (C->pipeline) {
+                // Statements still queued are executed, errors are ignored
+                C->pipeline = false;
+                if (! C->op->endPipeline(C->D))
+                        DEBUG("Pipeline failed -- %s\n", Connection_getLastError(C));
+        }
+}
+
+
 static void _freePrepared(T C) {
         while (! Vector_isEmpty(C->prepared)) {
                 PreparedStatement_T ps = Vector_pop(C->prepared);
                 PreparedStatement_free(&ps);
         }
+        // Cached statements are kept, but their result sets are closed
+        for (int i = 0; i < Vector_size(C->statements); i++) {
+                statement_t s = Vector_get(C->statements, i);
+                if (s->p)
+                        PreparedStatement_clear(s->p);
+        }
+}
+
+
+/* FNV-1a */
+static inline uint32_t _hash(const char *s) {
+        uint32_t h = 2166136261u;
+        for (; *s; s++)
+                h = (h ^ (unsigned char)*s) * 16777619u;
+        return h;
+}
+
+
+static void _removeStatement(T C, int i) {
+        statement_t s = Vector_remove(C->statements, i);
+        if (! s->pinned) {
+                C->cached--;
+                C->cacheMemory -= strlen(s->sql) + 1;
+        }
+        if (s->p)
+                PreparedStatement_free(&s->p);
+        FREE(s->sql);
+        FREE(s);
+}
+
+
+/* Evict the least recently used statement not used in this check-out. 
+ Returns false if there is none */
+static bool _evictStatement(T C) {
+        int victim = -1;
+        for (int i = 0; i < Vector_size(C->statements); i++) {
+                statement_t s = Vector_get(C->statements, i);
+                if (! s->pinned && s->lastUsed < C->checkedOut && (victim < 0 || s->lastUsed < ((statement_t)Vector_get(C->statements, victim))->lastUsed))
+                        victim = i;
+        }
+        if (victim < 0)
+                return false;
+        _removeStatement(C, victim);
+        return true;
+}
+
+
+/* Statements do not survive a reconnect (MySQL reconnects automatically). 
+ Invalidated statements which may be in use are freed when the Connection 
+ is cleared and pinned statements are prepared again when next used */
+static void _checkSession(T C) {
+        if (! C->op->sessionId)
+                return;
+        long long session = C->op->sessionId(C->D);
+        if (session == C->session)
+                return;
+        DEBUG("Connection reconnected, invalidating %d prepared statements\n", Vector_size(C->statements));
+        C->session = session;
+        for (int i = 0; i < Vector_size(C->statements); i++) {
+                statement_t s = Vector_get(C->statements, i);
+                if (s->p)
+                        Vector_push(C->prepared, s->p);
+                s->p = NULL;
+                if (! s->pinned)
+                        _removeStatement(C, i--);
+        }
+}
+
+
+/* Returns the cached statement for sql or prepares and caches it if the cache
+ limits allow. A cached statement already returned in this check-out may be
+ in use, so a statement of its own is prepared instead. Takes ownership of sql */
+static PreparedStatement_T _cachedStatement(T C, char *sql) {
+        _checkSession(C);
+        bool inUse = false;
+        uint32_t hash = _hash(sql);
+        long long tick = ++C->tick;
+        for (int i = 0; i < Vector_size(C->statements); i++) {
+                statement_t s = Vector_get(C->statements, i);
+                if (s->hash == hash && Str_isByteEqual(s->sql, sql)) {
+                        if ((inUse = (s->p && s->lastUsed >= C->checkedOut)))
+                                break;
+                        FREE(sql);
+                        ConnectionPool_reportStatement(C->parent, s->p != NULL);
+                        if (! s->p && ! (s->p = _prepare(C, "%s", s->sql)))
+                                return NULL;
+                        s->lastUsed = tick;
+                        return s->p;
+                }
+        }
+        ConnectionPool_reportStatement(C->parent, false);
+        PreparedStatement_T p = _prepare(C, "%s", sql);
+        if (p && ! inUse) {
+                int size = ConnectionPool_getStatementCacheSize(C->parent);
+                long memory = ConnectionPool_getStatementCacheMemory(C->parent);
+                long length = strlen(sql) + 1;
+                while ((C->cached >= size || (memory && C->cacheMemory + length > memory)) && C->cached > 0 && _evictStatement(C))
+                        ;
+                if (C->cached < size && ! (memory && C->cacheMemory + length > memory)) {
+                        statement_t s;
+                        NEW(s);
+                        s->sql = sql;
+                        s->hash = hash;
+                        s->lastUsed = tick;
+                        s->p = p;
+                        Vector_push(C->statements, s);
+                        C->cached++;
+                        C->cacheMemory += length;
+                        return p;
+                }
+        }
+        if (p)
+                Vector_push(C->prepared, p);
+        FREE(sql);
+        return p;
 }
 
 
@@ -137,10 +369,10 @@ T Connection_new(void *pool, char **error) {
         C->isAvailable = true;
         C->isInTransaction = false;
         C->prepared = Vector_new(4);
-        C->lastAccessedTime = Time_now();
+        C->statements = Vector_new(4);
+        C->lastAccessedTime = Time_micro();
         C->url = ConnectionPool_getURL(pool);
-        C->fetchSize = SQL_DEFAULT_PREFETCH_ROWS;
-        if (! _setDelegate(C, error)) {
+        if (! (_connect(C, error) && _init(C, error))) {
                 Connection_free(&C);
         } else {
                 C->fetchSizeDefault = C->fetchSize;
@@ -153,6 +385,9 @@ void Connection_free(T *C) {
         assert(C && *C);
         Connection_clear((*C));
         Vector_free(&((*C)->prepared));
+        while (! Vector_isEmpty((*C)->statements))
+                _removeStatement((*C), 0);
+        Vector_free(&((*C)->statements));
         if ((*C)->D)
                 (*C)->op->free(&((*C)->D));
         FREE(*C);
@@ -161,8 +396,14 @@ void Connection_free(T *C) {
 
 void Connection_setAvailable(T C, bool isAvailable) {
         assert(C);
+        C->lastAccessedTime = Time_micro();
+        if (! isAvailable) {
+                C->checkedOut = ++C->tick;
+                C->tag = NULL;
+                C->leaked = false;
+                C->held = 1;
+        }
         C->isAvailable = isAvailable;
-        C->lastAccessedTime = Time_now();
 }
 
 
@@ -173,6 +414,12 @@ bool Connection_isAvailable(T C) {
 
 
 time_t Connection_getLastAccessedTime(T C) {
+        assert(C);
+        return (time_t)(C->lastAccessedTime / USEC_PER_SEC);
+}
+
+
+long long Connection_getLastAccessedMicro(T C) {
         assert(C);
         return C->lastAccessedTime;
 }
@@ -184,6 +431,152 @@ bool Connection_isInTransaction(T C) {
 }
 
 
+long long Connection_getReplicationLag(T C) {
+        assert(C);
+        return C->op->replicationLag ? C->op->replicationLag(C->D) : -1;
+}
+
+
+bool Connection_hasReplayed(T C, const char *position) {
+        assert(C);
+        assert(position);
+        return C->op->hasReplayed ? C->op->hasReplayed(C->D, position) : false;
+}
+
+
+void Connection_addPreparedStatement(T C, const char *sql) {
+        assert(C);
+        assert(sql);
+        PreparedStatement_T p = _prepare(C, "%s", sql);
+        if (! p)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        statement_t s;
+        NEW(s);
+        s->sql = Str_dup(sql);
+        s->hash = _hash(sql);
+        s->pinned = true;
+        s->p = p;
+        Vector_push(C->statements, s);
+}
+
+
+void Connection_setTag(T C, const char *tag) {
+        assert(C);
+        C->tag = tag;
+}
+
+
+const char *Connection_getTag(T C) {
+        assert(C);
+        return C->tag;
+}
+
+
+bool Connection_markLeaked(T C) {
+        assert(C);
+        if (C->leaked)
+                return false;
+        C->leaked = true;
+        return true;
+}
+
+
+bool Connection_release(T C) {
+        assert(C);
+        return (--C->held == 0); // decrement is atomic
+}
+
+
+void Connection_setPriority(T C, int priority) {
+        assert(C);
+        C->priority = priority;
+}
+
+
+int Connection_getPriority(T C) {
+        assert(C);
+        return C->priority;
+}
+
+
+bool Connection_needsReset(T C) {
+        assert(C);
+        return (C->isInTransaction || C->pipeline || C->loader || C->resultSet || C->queryTimeout || ! Vector_isEmpty(C->prepared));
+}
+
+
+bool Connection_reset(T C, bool discard) {
+        assert(C);
+        volatile bool ok = true;
+        if (discard && C->op->reset) {
+                // The session reset deallocates prepared statements and resets the query timeout, so clearing them afterwards takes no round-trips
+                _closeResults(C);
+                if (C->isInTransaction) {
+                        C->isInTransaction = 0;
+                        ok = C->op->rollback(C->D);
+                }
+                if (ok && C->op->reset(C->D)) {
+                        for (int i = 0; i < Vector_size(C->prepared); i++)
+                                PreparedStatement_discard(Vector_get(C->prepared, i));
+                        C->queryTimeout = 0;
+                } else {
+                        DEBUG("Failed to reset session -- %s\n", Connection_getLastError(C));
+                        ok = false;
+                }
+        } else if (C->isInTransaction) {
+                TRY
+                        Connection_rollback(C);
+                ELSE
+                {
+                        DEBUG("Failed to rollback transaction -- %s\n", Exception_frame.message);
+                        ok = false;
+                }
+                END_TRY;
+        }
+        Connection_clear(C);
+        return ok;
+}
+
+
+PreparedStatement_T Connection_prepareBatchStatement(T C, const char *sql) {
+        assert(C);
+        assert(sql);
+        return _prepare(C, "%s", sql);
+}
+
+
+int Connection_getBatchLimits(T C, long *maxPacket) {
+        assert(C);
+        assert(maxPacket);
+        *maxPacket = C->op->maxPacket ? C->op->maxPacket(C->D) : 0;
+        return C->op->maxParameters ? C->op->maxParameters(C->D) : 0;
+}
+
+
+const char *Connection_getHost(T C) {
+        assert(C);
+        return URL_getHostCount(C->url) ? URL_getHostAt(C->url, C->host) : NULL;
+}
+
+
+int Connection_getPort(T C) {
+        assert(C);
+        return URL_getHostCount(C->url) ? URL_getPortAt(C->url, C->host) : URL_getPort(C->url);
+}
+
+
+int Connection_getHostIndex(T C) {
+        assert(C);
+        return C->host;
+}
+
+
+bool Connection_isFetchSizeSet(T C) {
+        assert(C);
+        return C->fetchSize != 0;
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -229,7 +622,7 @@ void Connection_setFetchSize(T C, int rows) {
 
 int Connection_getFetchSize(T C) {
         assert(C);
-        return C->fetchSize;
+        return C->fetchSize ? C->fetchSize : SQL_DEFAULT_PREFETCH_ROWS;
 }
 
 
@@ -238,15 +631,20 @@ int Connection_getFetchSize(T C) {
 
 bool Connection_ping(T C) {
         assert(C);
-        return C->op->ping(C->D);
+        long long start = Time_micro();
+        bool alive = C->op->ping(C->D);
+        // A failed ping may only mean the server closed an idle Connection, so only connect failures eject a host
+        if (alive)
+                ConnectionPool_reportHost(C->parent, C->host, Time_micro() - start, true);
+        return alive;
 }
 
 
 void Connection_clear(T C) {
         assert(C);
-        if (C->resultSet)
-                ResultSet_free(&C->resultSet);
+        _closeResults(C);
         _freePrepared(C);
+        FREE(C->position);
         // Set properties back to default values
         C->maxRows = 0;
         if (C->queryTimeout != 0)
@@ -292,6 +690,26 @@ void Connection_rollback(T C) {
 }
 
 
+void Connection_beginPipeline(T C) {
+        assert(C);
+        if (C->op->beginPipeline && ! C->pipeline) {
+                if (! C->op->beginPipeline(C->D))
+                        THROW(SQLException, "%s", Connection_getLastError(C));
+                C->pipeline = true;
+        }
+}
+
+
+void Connection_endPipeline(T C) {
+        assert(C);
+        if (C->pipeline) {
+                C->pipeline = false;
+                if (! C->op->endPipeline(C->D))
+                        THROW(SQLException, "%s", Connection_getLastError(C));
+        }
+}
+
+
 long long Connection_lastRowId(T C) {
         assert(C);
         return C->op->lastRowId(C->D);
@@ -335,18 +753,75 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) {
 PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) {
         assert(C);
         assert(sql);
+        PreparedStatement_T p;
         va_list ap;
         va_start(ap, sql);
-        PreparedStatement_T p = C->op->prepareStatement(C->D, sql, ap);
+        bool cache = ! Vector_isEmpty(C->statements) || ConnectionPool_getStatementCacheSize(C->parent);
+        if (! ConnectionPool_getBatchRewrite(C->parent)) {
+                if (cache) {
+                        // The cache is keyed by the final SQL text
+                        p = _cachedStatement(C, Str_vcat(sql, ap));
+                } else if ((p = C->op->prepareStatement(C->D, sql, ap))) {
+                        Vector_push(C->prepared, p);
+                }
+        } else {
+                // The statement's batch may be rewritten from its SQL text
+                char *s = Str_vcat(sql, ap);
+                if (cache)
+                        p = _cachedStatement(C, Str_dup(s));
+                else if ((p = _prepare(C, "%s", s)))
+                        Vector_push(C->prepared, p);
+                if (p)
+                        PreparedStatement_setBatchRewrite(p, C, s);
+                FREE(s);
+        }
         va_end(ap);
-        if (p)
-                Vector_push(C->prepared, p);
-        else
+        if (! p)
                 THROW(SQLException, "%s", Connection_getLastError(C));
         return p;
 }
 
 
+BulkLoader_T Connection_bulkLoad(T C, const char *table, const char *columns) {
+        assert(C);
+        assert(table);
+        assert(columns);
+        if (C->pipeline)
+                THROW(SQLException, "Bulk load is not supported in pipeline mode");
+        if (C->resultSet)
+                ResultSet_free(&C->resultSet);
+        if (C->loader)
+                BulkLoader_free(&C->loader);
+        int count = _columnCount(columns);
+        bool transaction = ! C->isInTransaction;
+        if (transaction)
+                Connection_beginTransaction(C);
+        if (C->op->bulkLoad) {
+                C->loader = C->op->bulkLoad(C->D, table, columns, count);
+        } else {
+                char *parameters = CALLOC(count, 3);
+                for (int i = 0; i < count; i++)
+                        strcat(parameters, i ? ", ?" : "?");
+                PreparedStatement_T p = _prepare(C, "INSERT INTO %s (%s) VALUES (%s)", table, columns, parameters);
+                FREE(parameters);
+                if (p)
+                        C->loader = BulkLoader_newWithStatement(p);
+        }
+        if (! C->loader) {
+                char error[STRLEN];
+                snprintf(error, STRLEN, "%s", Connection_getLastError(C));
+                if (transaction) {
+                        C->op->rollback(C->D);
+                        C->isInTransaction = 0;
+                }
+                THROW(SQLException, "%s", error);
+        }
+        if (transaction)
+                BulkLoader_setTransaction(C->loader, C);
+        return C->loader;
+}
+
+
 const char *Connection_getLastError(T C) {
         assert(C);
         const char *s = C->op->getLastError(C->D);
@@ -354,6 +829,18 @@ const char *Connection_getLastError(T C) {
 }
 
 
+const char *Connection_getReplicationPosition(T C) {
+        assert(C);
+        if (! C->op->replicationPosition)
+                return NULL;
+        FREE(C->position);
+        C->position = C->op->replicationPosition(C->D);
+        if (! C->position)
+                THROW(SQLException, "%s", Connection_getLastError(C));
+        return C->position;
+}
+
+
 bool Connection_isSupported(const char *url) {
         return (url ? (_getOp(url) != NULL) : false);
 }
@@ -57,9 +57,33 @@
  * A transaction will also rollback if the database is closed or if an 
  * error occurs. Nested transactions are not allowed.
  *
+ * <h2 class="desc">Pipeline:</h2>
+ * Between Connection_beginPipeline() and Connection_endPipeline() statements
+ * executed with Connection_execute(), PreparedStatement_execute() and
+ * PreparedStatement_executeBatch(), as well as begin, commit and rollback,
+ * are sent without waiting for their results. A query, or preparing a 
+ * statement, sends the queued statements with it and reads their results in
+ * order, and Connection_endPipeline() reads the results of the rest. A 
+ * transaction of N statements then takes one round-trip instead of N:
+ * <pre>
+ * Connection_beginPipeline(con);
+ * Connection_beginTransaction(con);
+ * for (int i = 0; i < 100; i++) {
+ *         PreparedStatement_setInt32(p, 1, i);
+ *         PreparedStatement_execute(p);
+ * }
+ * Connection_commit(con);
+ * Connection_endPipeline(con);
+ * </pre>
+ * Errors of a queued statement are thrown by the query or by 
+ * Connection_endPipeline() which reads its result, and the statements queued
+ * after it are not executed. Rows changed and the last row id are not 
+ * known for queued statements. Pipelining is supported by PostgreSQL 14
+ * and later; with other databases statements are executed immediately.
+ *
  * <i>A Connection is reentrant, but not thread-safe and should only be used by one thread (at the time).</i>
  *
- * @see ResultSet.h PreparedStatement.h SQLException.h
+ * @see ResultSet.h PreparedStatement.h BulkLoader.h SQLException.h
  * @file
  */
 
@@ -112,6 +136,16 @@ bool Connection_isAvailable(T C) __attribute__ ((visibility("hidden")));
 time_t Connection_getLastAccessedTime(T C) __attribute__ ((visibility("hidden")));
 
 
+/**
+ * Return the last time this Connection was accessed from the Connection Pool
+ * as the number of microseconds since midnight, January 1, 1970 GMT.
+ * @param C A Connection object
+ * @return The last time (microseconds) this Connection was accessed
+ * @see Connection_getLastAccessedTime
+ */
+long long Connection_getLastAccessedMicro(T C) __attribute__ ((visibility("hidden")));
+
+
 /**
  * Return true if this Connection is in a transaction that has not
  * been committed.
@@ -121,6 +155,181 @@ time_t Connection_getLastAccessedTime(T C) __attribute__ ((visibility("hidden"))
 bool Connection_isInTransaction(T C) __attribute__ ((visibility("hidden")));
 
 
+/**
+ * Returns how far behind its primary this Connection's database server is,
+ * if it is a replica.
+ * @param C A Connection object
+ * @return The replication lag in milliseconds, 0 if the server is not a 
+ * replica or -1 if the lag is unknown or not supported by the database system
+ */
+long long Connection_getReplicationLag(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns true if this Connection's database server has replayed all
+ * changes up to a replication position
+ * @param C A Connection object
+ * @param position A replication position from 
+ * Connection_getReplicationPosition()
+ * @return true if the server has caught up with position, false if not or
+ * if replication positions are not supported by the database system
+ */
+bool Connection_hasReplayed(T C, const char *position) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the host this Connection is connected to. With a multi-host URL
+ * this is the host chosen by the pool when the Connection was opened,
+ * otherwise the same as URL_getHost(). Used by delegates to connect.
+ * @param C A Connection object
+ * @return The hostname or NULL if the URL does not have a host
+ */
+const char *Connection_getHost(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the port of the host this Connection is connected to
+ * @param C A Connection object
+ * @return The port number or -1 if not specified
+ * @see Connection_getHost
+ */
+int Connection_getPort(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the index in the URL of the host this Connection is connected to
+ * @param C A Connection object
+ * @return The host index, 0 for a single host URL
+ * @see URL_getHostAt
+ */
+int Connection_getHostIndex(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns true if a fetch size was set with Connection_setFetchSize() or
+ * the URL parameter <code>fetch-size</code>. Used by delegates which only
+ * stream rows when asked to.
+ * @param C A Connection object
+ * @return true if the fetch size was set, false if it is the default
+ */
+bool Connection_isFetchSizeSet(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Prepare a statement which is kept as long as this Connection is open.
+ * Connection_prepareStatement() returns this statement when called with the
+ * same SQL. Called when the Connection is initialized.
+ * @param C A Connection object
+ * @param sql A SQL statement
+ * @exception SQLException If a database error occurs
+ * @see ConnectionPool_addPreparedStatement
+ */
+void Connection_addPreparedStatement(T C, const char *sql) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Set a tag identifying the code which checked out this Connection. The
+ * tag is cleared when the Connection is checked out again.
+ * @param C A Connection object
+ * @param tag A string which must remain valid, such as a string literal,
+ * or NULL
+ * @see ConnectionPool_getConnectionWithTag
+ */
+void Connection_setTag(T C, const char *tag) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the tag identifying the code which checked out this Connection
+ * @param C A Connection object
+ * @return The tag or NULL if not set
+ */
+const char *Connection_getTag(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Mark this Connection as reported leaked. 
+ * @param C A Connection object
+ * @return true the first time this method is called after the Connection
+ * was checked out, otherwise false
+ */
+bool Connection_markLeaked(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Release the hold on a checked out Connection. Both the pool, when a 
+ * Connection is returned, and the reaper, when it reclaims a leaked 
+ * Connection, call this method and only the first caller is given the 
+ * Connection. 
+ * @param C A Connection object
+ * @return true if this call released the Connection, false if it was 
+ * already released
+ */
+bool Connection_release(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Set the priority class this Connection was checked out in
+ * @param C A Connection object
+ * @param priority The priority class
+ * @see ConnectionPool_getConnectionWithPriority
+ */
+void Connection_setPriority(T C, int priority) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the priority class this Connection was checked out in
+ * @param C A Connection object
+ * @return The priority class
+ */
+int Connection_getPriority(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns true if returning the Connection to the pool requires round 
+ * trips to the database, that is, if a transaction must be rolled back or
+ * result sets, prepared statements or the query timeout must be cleared
+ * @param C A Connection object
+ * @return true if Connection_reset() should be deferred
+ */
+bool Connection_needsReset(T C) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Prepare a returned Connection for reuse. Roll back an open transaction 
+ * and clear the Connection. If <code>discard</code> is true and the 
+ * database supports it, the session is also reset on the server, which 
+ * removes temporary tables, session variables and locks left by the 
+ * application. The reset also deallocates prepared statements, which 
+ * are then freed without a round-trip each.
+ * @param C A Connection object
+ * @param discard Reset the session on the server
+ * @return false if the rollback or server reset failed
+ */
+bool Connection_reset(T C, bool discard) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Prepare a statement which is not kept by the Connection. Used by a
+ * PreparedStatement to execute its batch as multi-row INSERT statements.
+ * The caller must free the statement before the Connection is freed.
+ * @param C A Connection object
+ * @param sql The SQL statement, used as-is
+ * @return A PreparedStatement or NULL on error
+ */
+PreparedStatement_T Connection_prepareBatchStatement(T C, const char *sql) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Returns the limits on a multi-row INSERT statement
+ * @param C A Connection object
+ * @param maxPacket Set to the maximum size in bytes of a message to the
+ * server or 0 if not limited
+ * @return The maximum number of parameters in a statement or 0 if batches
+ * are not rewritten to multi-row INSERT for this database
+ */
+int Connection_getBatchLimits(T C, long *maxPacket) __attribute__ ((visibility("hidden")));
+
+
 //>> End Protected methods
 
 /** @name Properties */
@@ -176,7 +385,17 @@ int Connection_getMaxRows(T C);
  * prefetch rows in batches of 100 rows to reduce the network roundtrip
  * to the database. This value can also be set via the URL parameter
  * <code>fetch-size</code> to apply to all connections. This method and
- * the concept of pre-fetching rows are only applicable to MySQL and Oracle.
+ * the concept of pre-fetching rows are applicable to MySQL, Oracle and
+ * PostgreSQL.
+ *
+ * PostgreSQL by default reads the whole result of a query into memory
+ * before the first row is returned. If a fetch size is set, rows are
+ * instead streamed from the server as they are read, at most
+ * <code>rows</code> at a time, so memory use is bounded regardless of
+ * the size of the result. While a streaming ResultSet is open, the 
+ * Connection cannot execute other statements until the ResultSet is read
+ * to the end or closed, which in turn will read and discard the rows 
+ * that remain.
  * @param C A Connection object
  * @param rows The number of rows to fetch (1..INT.MAX)
  * @exception AssertException If <code>rows</code> is less than 1
@@ -265,6 +484,35 @@ void Connection_commit(T C);
 void Connection_rollback(T C);
 
 
+/**
+ * Start pipeline mode. Statements executed on this Connection are queued
+ * and sent without waiting for their results until Connection_endPipeline()
+ * is called. Does nothing if the database does not support pipelining or
+ * if the Connection is already in pipeline mode. With pipeline mode, 
+ * Connection_execute() can only execute one SQL statement at a time.
+ * @param C A Connection object
+ * @exception SQLException If a database error occurs
+ * @see SQLException.h
+ */
+void Connection_beginPipeline(T C);
+
+
+/**
+ * End pipeline mode. Read the results of all statements queued since
+ * Connection_beginPipeline() or the last query, in order. So neither the
+ * client nor the database blocks on a full socket buffer, results are 
+ * also read after every 1000 queued statements. A statement that failed
+ * is then reported by the execute call that queued the 1000th statement.
+ * If the Connection is returned to the pool in pipeline mode, queued 
+ * statements are executed and their errors ignored.
+ * @param C A Connection object
+ * @exception SQLException If a queued statement failed. Statements queued
+ * after it were not executed
+ * @see SQLException.h
+ */
+void Connection_endPipeline(T C);
+
+
 /**
  * Returns the value for the most recent INSERT statement into a 
  * table with an AUTO_INCREMENT or INTEGER PRIMARY KEY column.
@@ -331,7 +579,15 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((fo
  * setXXX methods. Only <i>one</i> SQL statement may be used in the sql 
  * parameter, this in difference to Connection_execute() which may 
  * take several statements. A PreparedStatement "lives" until the 
- * Connection is returned to the Connection Pool. 
+ * Connection is returned to the Connection Pool. If <code>sql</code> was
+ * added with ConnectionPool_addPreparedStatement(), the statement prepared
+ * when the Connection was opened is returned instead and it lives as long
+ * as the Connection. Likewise, if the pool has a statement cache, see 
+ * ConnectionPool_setStatementCache(), a statement prepared earlier on this
+ * Connection with the same SQL text is returned from the cache. A cached
+ * statement is returned once per check-out; preparing the same SQL again
+ * before the Connection is returned gives a new statement, so the two can
+ * be used at the same time.
  * @param C A Connection object
  * @param sql A single SQL statement that may contain one or more '?' 
  * IN parameter placeholders
@@ -344,6 +600,26 @@ ResultSet_T Connection_executeQuery(T C, const char *sql, ...) __attribute__((fo
 PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) __attribute__((format (printf, 2, 3)));
 
 
+/**
+ * Start loading rows into a table with the fastest method the database
+ * provides, such as COPY on PostgreSQL or LOAD DATA LOCAL INFILE on MySQL.
+ * If the Connection is not in a transaction, a transaction is started and
+ * committed by BulkLoader_finish(). The returned BulkLoader lives until the
+ * next call to this method or until the Connection is returned to the pool.
+ * <b>Note</b>, calling this method clears any previous ResultSets 
+ * associated with the Connection.
+ * @param C A Connection object
+ * @param table The table to load rows into
+ * @param columns A comma separated list of the table's columns to load,
+ * e.g. "id, name, photo"
+ * @return A BulkLoader
+ * @exception SQLException If a database error occurs or if the Connection
+ * is in pipeline mode
+ * @see BulkLoader.h SQLException.h
+ */
+BulkLoader_T Connection_bulkLoad(T C, const char *table, const char *columns);
+
+
 /**
  * This method can be used to obtain a string describing the last
  * error that occurred. Inside a CATCH-block you can also find
@@ -357,6 +633,22 @@ PreparedStatement_T Connection_prepareStatement(T C, const char *sql, ...) __att
 const char *Connection_getLastError(T C);
 
 
+/**
+ * Returns the current replication position of the database server. For
+ * PostgreSQL this is the WAL location (LSN) and for MySQL the executed 
+ * GTID set. Call this method after a write on the primary and pass the
+ * position to ConnectionPool_getReadConnection() to read your own writes
+ * from a replica.
+ * @param C A Connection object
+ * @return The replication position or NULL if not supported by the 
+ * database system. The string is valid until the next call of this method 
+ * or until the Connection is returned to the pool
+ * @exception SQLException If a database error occurs
+ * @see ConnectionPool_getReadConnection
+ */
+const char *Connection_getReplicationPosition(T C);
+
+
 /** @name Class methods */
 //@{
 
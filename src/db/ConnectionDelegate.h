@@ -53,6 +53,23 @@ typedef struct Cop_T {
         ResultSet_T (*executeQuery)(T C, const char *sql, va_list ap);
         PreparedStatement_T (*prepareStatement)(T C, const char *sql, va_list ap);
         const char *(*getLastError)(T C);
+        // Optional replication methods
+        long long (*replicationLag)(T C);
+        char *(*replicationPosition)(T C);
+        bool (*hasReplayed)(T C, const char *position);
+        // Optional server-side session reset
+        bool (*reset)(T C);
+        // Optional id of the server session, which changes if the client reconnects
+        long long (*sessionId)(T C);
+        // Optional, maximum parameters in a statement. Batches are only rewritten to multi-row INSERT if set
+        int (*maxParameters)(T C);
+        // Optional, maximum size in bytes of a message to the server
+        long (*maxPacket)(T C);
+        // Optional pipeline mode. Statements are queued until endPipeline
+        bool (*beginPipeline)(T C);
+        bool (*endPipeline)(T C);
+        // Optional native bulk load. Rows are inserted with a batch of a prepared INSERT if not set
+        BulkLoader_T (*bulkLoad)(T C, const char *table, const char *columns, int columnCount);
 } *Cop_T;
 
 #undef T
@@ -27,6 +27,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#ifdef HAVE_STDATOMIC_H
+#include <stdatomic.h>
+#else
+#define _Atomic(x) volatile x
+#endif
 
 #include "URL.h"
 #include "Thread.h"
@@ -34,6 +42,7 @@
 #include "Vector.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
+#include "BulkLoader.h"
 #include "Connection.h"
 #include "ConnectionPool.h"
 
@@ -48,22 +57,184 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+/*
+ * Idle connections are kept in a set of shards, each a LIFO stack with its
+ * own mutex. A thread is bound to one shard and pushes and pops connections
+ * there, so check-out and return seldom contend and a thread usually gets
+ * back the (cache-warm) connection it returned last. If the home shard is
+ * empty, a connection is stolen from one of the other shards. The global
+ * pool mutex is only used when connections are created or destroyed and 
+ * protects the pool vector which holds all connections, idle or active.
+ * Statistics are counted in the shard of the thread doing the work so 
+ * threads on different CPUs do not update the same counters.
+ */
+typedef struct shard_t {
+        Mutex_T mutex;
+        Vector_T idle;
+        struct counters_t {
+                _Atomic(long long) checkouts;
+                _Atomic(long long) timeouts;
+                _Atomic(long long) creations;
+                _Atomic(long long) failures;
+                _Atomic(long long) reaped;
+                _Atomic(long long) leaks;
+                _Atomic(long long) shed;
+                _Atomic(long long) trips;
+                _Atomic(long long) statementHits;
+                _Atomic(long long) statementMisses;
+                _Atomic(long long) checkoutLockTime;
+                _Atomic(long long) waitTimeSum;
+                _Atomic(long long) holdTimeSum;
+                _Atomic(long long) waitTime[LIBZDB_HISTOGRAM_BUCKETS];
+                _Atomic(long long) holdTime[LIBZDB_HISTOGRAM_BUCKETS];
+        } stats;
+} *shard_t;
+/*
+ * Threads waiting in ConnectionPool_getConnectionWithTimeout() are queued FIFO 
+ * per priority class and each parks on its own condition. A returned 
+ * connection is handed directly to a waiter. The queues are protected by 
+ * the pool mutex
+ */
+typedef struct waiter_t {
+        Sem_T cond;
+        int priority;
+        Connection_T con;
+        struct waiter_t *next;
+} *waiter_t;
+/*
+ * Check-outs are admitted per priority class. A class may have Connections
+ * reserved which other classes cannot take and a limit on its active
+ * Connections. Of the classes with waiters which can be admitted, the head
+ * waiter of the class with the lowest virtual time is served next and the
+ * class's virtual time then advances by VTIME_UNIT / weight, so classes are
+ * served in proportion to their weight (weighted fair queueing)
+ */
+typedef struct class_t {
+        waiter_t head;
+        waiter_t tail;
+        int waiting;
+        _Atomic(int) active;
+        int reserved;
+        int limit;
+        int weight;
+        int maxWaiting;
+        long long vtime;
+} *class_t;
+#define VTIME_UNIT 1000000LL
+/*
+ * A read replica is served by its own ConnectionPool so its Connections are
+ * returned to the replica's pool on close. Latency and replication lag are
+ * measured by the primary pool's reaper thread
+ */
+typedef struct replica_t {
+        struct ConnectionPool_S *pool;
+        _Atomic(long long) latency;
+        _Atomic(long long) lag;
+        volatile bool healthy;
+} *replica_t;
+/*
+ * Health of each host in a multi-host URL. Connect and ping latency is 
+ * reported by Connection_new() and Connection_ping() and a host which cannot
+ * be connected to is ejected until a backoff time. Updated without locks
+ */
+typedef struct host_t {
+        _Atomic(long long) latency; // Moving average in microseconds, 0 if not measured
+        _Atomic(long long) ejected; // Not used before this time in microseconds
+        _Atomic(int) failures; // Consecutive connect failures
+} *host_t;
+/*
+ * Circuit breaker on opening Connections. After <i>threshold</i> 
+ * consecutive failed connects the circuit opens and no Connection is opened
+ * until a backoff time, which doubles on each trip up to maxBackoff and is
+ * jittered so that pools do not retry in lockstep. Then one connect is let
+ * through as a probe (half-open). If it succeeds the circuit closes, 
+ * otherwise it opens again. Protected by the pool mutex
+ */
+typedef struct breaker_t {
+        Circuit_T state;
+        int failures; // Consecutive failed connects
+        int threshold;
+        int maxBackoff;
+        long long backoff; // Backoff of the last trip in milliseconds
+        long long retry; // Time in microseconds when a probe is let through
+} *breaker_t;
+/*
+ * Connections opened when the pool is started or closed when it is stopped
+ * are processed in parallel by up to SQL_MAX_CONNECT_THREADS threads. Each
+ * thread claims the next slot until all slots are done or, when opening, a
+ * connect has failed
+ */
+typedef struct batch_t {
+        struct ConnectionPool_S *pool;
+        int count;
+        _Atomic(int) next;
+        volatile bool failed;
+        struct slot_t {
+                Connection_T con;
+                char *error;
+        } *slots;
+} *batch_t;
 #define T ConnectionPool_T
 struct ConnectionPool_S {
         URL_T url;
         bool filled;
         bool doSweep;
+        bool doBuild;
+        bool doReset;
         char *error;
         Sem_T alarm;
+        Sem_T build;
 	Mutex_T mutex;
 	Vector_T pool;
+        shard_t shards;
+        int shardCount;
+        struct class_t classes[LIBZDB_PRIORITY_CLASSES];
+        bool limited; // A priority class has reserved Connections or a limit
+        long long vtime; // Virtual time of the last served class
+        _Atomic(int) waiting;
         Thread_T reaper;
+        Thread_T builder;
+        Thread_T resetter;
+        Mutex_T resetMutex;
+        Sem_T reset;
+        Vector_T resets; // Returned Connections waiting to be reset, protected by resetMutex
+        int minIdle;
+        int pending; // Connections being opened or closed with P->mutex unlocked
+        int targetUtilization;
+        struct breaker_t breaker;
+        host_t hosts;
+        int hostCount;
+        _Atomic(uint32_t) hostTicket;
+        char *initSQL;
+        Vector_T statements; // SQL to prepare on each new Connection
+        int statementCacheSize;
+        int statementCacheMemory;
+        bool batchRewrite;
+        void(*initializer)(Connection_T connection);
+        int leakThreshold;
+        bool leakReclaim;
+        void(*leakHandler)(const char *tag, long long heldTime);
+        Vector_T replicas;
+        int maxReplicationLag;
+        _Atomic(uint32_t) readTicket;
+        long long adaptTime;
+        Statistics_T adaptStats;
         int sweepInterval;
 	int maxConnections;
         volatile bool stopped;
+        _Atomic(int) active;
+        Validation_T validation;
+        int validationIdleTime;
         int connectionTimeout;
 	int initialConnections;
 };
+/* As LOCK/END_LOCK in Thread.h, but also count the time P->mutex is held.
+ Used on the check-out and return paths only */
+#define POOL_LOCK(P) LOCK((P)->mutex) long long _yylocked = Time_micro();
+#define POOL_END_LOCK(P) _stats(P)->checkoutLockTime += Time_micro() - _yylocked; END_LOCK
+static Once_T once_control = PTHREAD_ONCE_INIT;
+static ThreadData_T kShardKey;
+static _Atomic(uint32_t) kShardTicket = 0;
 
 int ZBDEBUG = false;
 #ifdef PACKAGE_PROTECTED
@@ -78,68 +249,810 @@ void(*AbortHandler)(const char *error) = NULL;
 /* ------------------------------------------------------- Private methods */
 
 
+static void _init_once(void) { ThreadData_create(kShardKey, NULL); }
+
+
+/* Returns the calling thread's home shard. A thread is given a ticket the
+ first time it use a pool and the ticket is used for all pools */
+static inline shard_t _getShard(T P) {
+        uintptr_t ticket = (uintptr_t)ThreadData_get(kShardKey);
+        if (! ticket) {
+                ticket = (uintptr_t)(kShardTicket++) + 1; // increment is atomic
+                ThreadData_set(kShardKey, (void *)ticket);
+        }
+        return &P->shards[(ticket - 1) % P->shardCount];
+}
+
+
+/* Returns the calling thread's statistics counters */
+static inline struct counters_t *_stats(T P) {
+        return &_getShard(P)->stats;
+}
+
+
+/* Add a duration in microseconds to a histogram */
+static inline void _record(_Atomic(long long) *histogram, _Atomic(long long) *sum, long long us) {
+        int b = 0;
+        if (us < 0)
+                us = 0;
+        *sum += us; // add is atomic
+        for (long long u = us; u > 0 && b < LIBZDB_HISTOGRAM_BUCKETS - 1; u >>= 1)
+                b++;
+        histogram[b]++; // increment is atomic
+}
+
+
+static inline Connection_T _popShard(shard_t shard) {
+        Connection_T con = NULL;
+        LOCK(shard->mutex)
+        {
+                if (! Vector_isEmpty(shard->idle))
+                        con = Vector_pop(shard->idle);
+        }
+        END_LOCK;
+        return con;
+}
+
+
+static inline void _pushShard(shard_t shard, Connection_T con) {
+        LOCK(shard->mutex)
+        {
+                Vector_push(shard->idle, con);
+        }
+        END_LOCK;
+}
+
+
+/* Pop an idle Connection from the home shard or steal one from another shard */
+static Connection_T _checkout(T P) {
+        shard_t home = _getShard(P);
+        Connection_T con = _popShard(home);
+        if (! con) {
+                int h = (int)(home - P->shards);
+                for (int i = 1; i < P->shardCount && ! con; i++)
+                        con = _popShard(&P->shards[(h + i) % P->shardCount]);
+        }
+        return con;
+}
+
+
+/* Returns true if a Connection can be given to class c without exceeding its
+ limit or taking Connections reserved for other classes. P->mutex must be locked */
+static inline bool _isAdmissible(T P, int c) {
+        class_t k = &P->classes[c];
+        if (k->limit && k->active >= k->limit)
+                return false;
+        int reserved = 0;
+        for (int i = 0; i < LIBZDB_PRIORITY_CLASSES; i++)
+                if (i != c && P->classes[i].active < P->classes[i].reserved)
+                        reserved += P->classes[i].reserved - P->classes[i].active;
+        return (reserved == 0 || P->maxConnections - P->active > reserved);
+}
+
+
+/* Returns the class whose head waiter should be served next or -1 if no 
+ waiter can be admitted. P->mutex must be locked */
+static int _nextClass(T P) {
+        int next = -1;
+        for (int c = 0; c < LIBZDB_PRIORITY_CLASSES; c++) {
+                class_t k = &P->classes[c];
+                if (k->head && _isAdmissible(P, c) && (next < 0 || k->vtime < P->classes[next].vtime))
+                        next = c;
+        }
+        return next;
+}
+
+
+/* Wake the builder and the next waiter so free capacity is used. P->mutex must be locked */
+static inline void _signalCapacity(T P) {
+        if (P->builder)
+                Sem_signal(P->build);
+        if (P->waiting > 0) {
+                int c = _nextClass(P);
+                if (c >= 0)
+                        Sem_signal(P->classes[c].head->cond);
+        }
+}
+
+
+/* Remove and close a Connection which is not in any shard. P->mutex must be locked */
+static void _removeConnection(T P, Connection_T con) {
+        for (int i = 0; i < Vector_size(P->pool); i++) {
+                if (Vector_get(P->pool, i) == con) {
+                        Vector_remove(P->pool, i);
+                        break;
+                }
+        }
+        Connection_free(&con);
+        _signalCapacity(P);
+}
+
+
+/* Take a Connection which is not in any shard out of the pool so it can be
+ pinged or closed with P->mutex unlocked. The Connection still count against
+ maxConnections until it is put back or closed. P->mutex must be locked */
+static void _detach(T P, Connection_T con) {
+        for (int i = 0; i < Vector_size(P->pool); i++) {
+                if (Vector_get(P->pool, i) == con) {
+                        Vector_remove(P->pool, i);
+                        break;
+                }
+        }
+        P->pending++;
+}
+
+
+/* Returns true if maxConnections is not reached, counting Connections opened
+ or closed outside the lock. P->mutex must be locked */
+static inline bool _hasCapacity(T P) {
+        return (Vector_size(P->pool) + P->pending < P->maxConnections);
+}
+
+
+/* Returns true if a Connection may be opened. When the circuit is open and
+ the backoff has expired, the caller is let through as the probe. P->mutex
+ must be locked */
+static bool _allowConnect(T P) {
+        breaker_t b = &P->breaker;
+        if (b->state == Circuit_closed)
+                return true;
+        if (b->state == Circuit_open && Time_micro() >= b->retry) {
+                DEBUG("Circuit half-open, probing the database\n");
+                b->state = Circuit_halfOpen;
+                return true;
+        }
+        return false;
+}
+
+
+/* Record the outcome of opening a Connection. P->mutex must be locked */
+static void _reportConnect(T P, bool ok) {
+        breaker_t b = &P->breaker;
+        if (ok) {
+                if (b->state != Circuit_closed)
+                        DEBUG("Circuit closed\n");
+                b->state = Circuit_closed;
+                b->failures = 0;
+                b->backoff = 0;
+                return;
+        }
+        b->failures++;
+        // A connect started before the circuit opened does not trip it again
+        if (b->threshold && b->state != Circuit_open && (b->state == Circuit_halfOpen || b->failures >= b->threshold)) {
+                b->backoff = b->backoff ? b->backoff * 2 : SQL_BREAKER_BACKOFF;
+                if (b->backoff > b->maxBackoff)
+                        b->backoff = b->maxBackoff;
+                // Retry after a random time between half and the full backoff
+                long long half = b->backoff * 500;
+                long long now = Time_micro();
+                b->retry = now + half + (now ^ (uintptr_t)P) % (half + 1);
+                b->state = Circuit_open;
+                _stats(P)->trips++; // increment is atomic
+                DEBUG("Circuit open for %lld ms after %d failed connects\n", (b->retry - now) / 1000, b->failures);
+        }
+}
+
+
+/* Create a new Connection if maxConnections is not reached and the circuit
+ breaker allows it. P->mutex must be locked */
+static Connection_T _newConnection(T P) {
+        Connection_T con = NULL;
+        if (_hasCapacity(P) && _allowConnect(P)) {
+                con = Connection_new(P, &P->error);
+                _reportConnect(P, con != NULL);
+                if (con) {
+                        Vector_push(P->pool, con);
+                        _stats(P)->creations++; // increment is atomic
+                } else {
+                        _stats(P)->failures++; // increment is atomic
+                        DEBUG("Failed to create connection -- %s\n", P->error);
+                        FREE(P->error);
+                }
+        }
+        return con;
+}
+
+
+static inline void _enqueue(T P, waiter_t w) {
+        class_t k = &P->classes[w->priority];
+        w->next = NULL;
+        if (k->tail) {
+                k->tail->next = w;
+        } else {
+                // A class which was idle does not get credit for the time it did not wait
+                if (k->vtime < P->vtime)
+                        k->vtime = P->vtime;
+                k->head = w;
+        }
+        k->tail = w;
+        k->waiting++;
+        P->waiting++;
+}
+
+
+static inline void _dequeue(T P, waiter_t w) {
+        class_t k = &P->classes[w->priority];
+        waiter_t prev = NULL;
+        for (waiter_t p = k->head; p; prev = p, p = p->next) {
+                if (p == w) {
+                        if (prev)
+                                prev->next = w->next;
+                        else
+                                k->head = w->next;
+                        if (k->tail == w)
+                                k->tail = prev;
+                        k->waiting--;
+                        P->waiting--;
+                        break;
+                }
+        }
+}
+
+
+/* Hand the Connection to the next waiter in weighted fair order. Returns 
+ false if no waiter can be admitted. P->mutex must be locked */
+static inline bool _handoff(T P, Connection_T con) {
+        int c = _nextClass(P);
+        if (c < 0)
+                return false;
+        class_t k = &P->classes[c];
+        waiter_t w = k->head;
+        _dequeue(P, w);
+        P->vtime = k->vtime;
+        k->vtime += VTIME_UNIT / k->weight;
+        k->active++; // increment is atomic
+        P->active++; // increment is atomic
+        w->con = con;
+        Sem_signal(w->cond);
+        return true;
+}
+
+
+/* Hand idle Connections to waiters which can be admitted. P->mutex must be locked */
+static void _dispatch(T P) {
+        Connection_T con;
+        while (_nextClass(P) >= 0 && (con = _checkout(P)))
+                _handoff(P, con);
+}
+
+
+static void *_doOpen(void *args) {
+        batch_t b = args;
+        for (int i; ! b->failed && (i = b->next++) < b->count;) { // increment is atomic
+                b->slots[i].con = Connection_new(b->pool, &b->slots[i].error);
+                if (! b->slots[i].con)
+                        b->failed = true;
+        }
+        return NULL;
+}
+
+
+static void *_doClose(void *args) {
+        batch_t b = args;
+        for (int i; (i = b->next++) < b->count;) // increment is atomic
+                Connection_free(&b->slots[i].con);
+        return NULL;
+}
+
+
+/* Run work over the batch's slots in up to SQL_MAX_CONNECT_THREADS threads,
+ the calling thread included */
+static void _runBatch(batch_t b, void *(*work)(void *)) {
+        Thread_T threads[SQL_MAX_CONNECT_THREADS];
+        int helpers = (b->count < SQL_MAX_CONNECT_THREADS ? b->count : SQL_MAX_CONNECT_THREADS) - 1;
+        for (int i = 0; i < helpers; i++)
+                Thread_create(threads[i], work, b);
+        work(b);
+        for (int i = 0; i < helpers; i++)
+                Thread_join(threads[i]);
+}
+
+
+/* Close all Connections in parallel. P->mutex must be locked */
 static void _drainPool(T P) {
-        while (! Vector_isEmpty(P->pool)) {
-		Connection_T con = Vector_pop(P->pool);
-		Connection_free(&con);
-	}
+        for (int i = 0; i < P->shardCount; i++) {
+                LOCK(P->shards[i].mutex)
+                {
+                        while (! Vector_isEmpty(P->shards[i].idle))
+                                Vector_pop(P->shards[i].idle);
+                }
+                END_LOCK;
+        }
+        // The reset thread is stopped, queued Connections are closed below
+        while (! Vector_isEmpty(P->resets))
+                Vector_pop(P->resets);
+        struct batch_t b = {.pool = P, .count = Vector_size(P->pool)};
+        if (b.count > 0) {
+                b.slots = CALLOC(b.count, sizeof *(b.slots));
+                for (int i = 0; i < b.count; i++)
+                        b.slots[i].con = Vector_pop(P->pool);
+                _runBatch(&b, _doClose);
+                FREE(b.slots);
+        }
+        P->active = 0;
+        for (int c = 0; c < LIBZDB_PRIORITY_CLASSES; c++)
+                P->classes[c].active = 0;
 }
 
 
+/* Open initialConnections in parallel. Returns false if none could be opened.
+ P->mutex must be locked */
 static bool _fillPool(T P) {
-	for (int i = 0; i < P->initialConnections; i++) {
-                Connection_T con = Connection_new(P, &P->error);
-		if (! con) {
-                        if (i > 0) {
-                                DEBUG("Failed to fill the pool with initial connections -- %s\n", P->error);
-                                FREE(P->error);
-                                return true;
+        int opened = 0;
+        struct batch_t b = {.pool = P, .count = P->initialConnections};
+        if (b.count == 0)
+                return true;
+        FREE(P->error);
+        b.slots = CALLOC(b.count, sizeof *(b.slots));
+        _runBatch(&b, _doOpen);
+        for (int i = 0; i < b.count; i++) {
+                if (b.slots[i].con) {
+                        Vector_push(P->pool, b.slots[i].con);
+                        _pushShard(&P->shards[opened++ % P->shardCount], b.slots[i].con);
+                        _stats(P)->creations++; // increment is atomic
+                } else if (b.slots[i].error) {
+                        _stats(P)->failures++; // increment is atomic
+                        if (P->error)
+                                FREE(b.slots[i].error);
+                        else
+                                P->error = b.slots[i].error;
+                }
+        }
+        FREE(b.slots);
+        if (opened > 0)
+                _reportConnect(P, true);
+        if (P->error && opened > 0) {
+                DEBUG("Failed to fill the pool with initial connections -- %s\n", P->error);
+                FREE(P->error);
+        }
+        return (opened > 0);
+}
+
+
+/* Returns true if the Connection can be handed out according to the validation policy */
+static inline bool _validate(T P, Connection_T con) {
+        if (P->validation == Validation_idle) {
+                if (P->validationIdleTime && (Time_micro() - Connection_getLastAccessedMicro(con) < P->validationIdleTime * 1000LL))
+                        return true;
+                return Connection_ping(con);
+        }
+        return true;
+}
+
+
+/* Ping idle Connections in the pool. Each Connection is detached from the 
+ pool while pinged so check-outs are not blocked. P->mutex must be unlocked */
+static void _keepAlive(T P) {
+        for (int s = 0; s < P->shardCount; s++) {
+                shard_t shard = &P->shards[s];
+                for (int i = 0; ! P->stopped; i++) {
+                        Connection_T con = NULL;
+                        LOCK(P->mutex)
+                        {
+                                LOCK(shard->mutex)
+                                {
+                                        if (i < Vector_size(shard->idle)) {
+                                                con = Vector_remove(shard->idle, i);
+                                                _detach(P, con);
+                                        }
+                                }
+                                END_LOCK;
+                        }
+                        END_LOCK;
+                        if (! con)
+                                break;
+                        bool alive = Connection_ping(con);
+                        LOCK(P->mutex)
+                        {
+                                P->pending--;
+                                if (alive && ! P->stopped) {
+                                        Vector_push(P->pool, con);
+                                        LOCK(shard->mutex)
+                                        {
+                                                // Put back at the same depth to not disturb the reap order
+                                                int size = Vector_size(shard->idle);
+                                                Vector_insert(shard->idle, i < size ? i : size, con);
+                                        }
+                                        END_LOCK;
+                                        con = NULL;
+                                }
                         }
-                        return false;
+                        END_LOCK;
+                        if (con) {
+                                Connection_free(&con);
+                                LOCK(P->mutex)
+                                {
+                                        _signalCapacity(P);
+                                }
+                                END_LOCK;
+                                if (! alive)
+                                        _stats(P)->reaped++; // increment is atomic
+                                i--;
+                        }
+                }
+        }
+        if (P->waiting > 0) {
+                LOCK(P->mutex)
+                {
+                        _dispatch(P);
                 }
-		Vector_push(P->pool, con);
-	}
-	return true;
+                END_LOCK;
+        }
 }
 
 
-static int _getActive(T P){
-        int i, n = 0, size = Vector_size(P->pool);
-        for (i = 0; i < size; i++)
-                if (! Connection_isAvailable(Vector_get(P->pool, i))) 
-                        n++; 
-        return n; 
+/* Open a Connection without holding P->mutex and add it to the pool, handing
+ it to the oldest waiter if any. Returns false if the Connection could not be
+ opened or the circuit breaker is open. P->mutex must be locked */
+static bool _build(T P) {
+        char *error = NULL;
+        if (! _allowConnect(P))
+                return false;
+        P->pending++;
+        Mutex_unlock(P->mutex);
+        Connection_T con = Connection_new(P, &error);
+        Mutex_lock(P->mutex);
+        P->pending--;
+        _reportConnect(P, con != NULL);
+        if (! con) {
+                _stats(P)->failures++; // increment is atomic
+                DEBUG("Failed to create connection -- %s\n", error);
+                FREE(error);
+                return false;
+        }
+        if (P->stopped) {
+                Connection_free(&con);
+        } else {
+                Vector_push(P->pool, con);
+                _stats(P)->creations++; // increment is atomic
+                if (! _handoff(P, con))
+                        _pushShard(&P->shards[Vector_size(P->pool) % P->shardCount], con);
+        }
+        return true;
 }
 
 
-static int _reapConnections(T P) {
+/* Close up to x idle Connections which were last used before timedout or 
+ fail the ping test, oldest first since each shard is a stack. At most 
+ SQL_MAX_REAP_BATCH Connections are examined per call. Candidates are detached
+ under the lock, while pinging and closing is done with P->mutex unlocked, so
+ check-outs are not stalled by the network. P->mutex must be locked */
+static int _closeIdle(T P, int x, time_t timedout) {
         int n = 0;
-        int x = Vector_size(P->pool) - _getActive(P) - P->initialConnections;
-        time_t timedout = Time_now() - P->connectionTimeout;
-        for (int i = 0; ((n < x) && (i < Vector_size(P->pool))); i++) {
-                Connection_T con = Vector_get(P->pool, i);
-                if (Connection_isAvailable(con)) {
-                        if ((Connection_getLastAccessedTime(con) < timedout) || (! Connection_ping(con))) {
-                                Vector_remove(P->pool, i);
+        Connection_T expired[SQL_MAX_REAP_BATCH];
+        if (x > SQL_MAX_REAP_BATCH)
+                x = SQL_MAX_REAP_BATCH;
+        // Expired Connections are detached without a round trip
+        for (int s = 0; ((n < x) && (s < P->shardCount)); s++) {
+                shard_t shard = &P->shards[s];
+                LOCK(shard->mutex)
+                {
+                        for (int i = 0; ((n < x) && (i < Vector_size(shard->idle))); i++) {
+                                Connection_T con = Vector_get(shard->idle, i);
+                                if (Connection_getLastAccessedTime(con) < timedout) {
+                                        Vector_remove(shard->idle, i--);
+                                        _detach(P, con);
+                                        expired[n++] = con;
+                                }
+                        }
+                }
+                END_LOCK;
+        }
+        int count = n;
+        int examined = n;
+        // Ping the remaining candidates one at a time and put back those alive at the same depth
+        for (int s = 0; ((n < x) && (examined < SQL_MAX_REAP_BATCH) && (s < P->shardCount) && ! P->stopped); s++) {
+                shard_t shard = &P->shards[s];
+                for (int i = 0; ((n < x) && (examined < SQL_MAX_REAP_BATCH) && ! P->stopped); i++) {
+                        Connection_T con = NULL;
+                        LOCK(shard->mutex)
+                        {
+                                if (i < Vector_size(shard->idle)) {
+                                        con = Vector_remove(shard->idle, i);
+                                        _detach(P, con);
+                                }
+                        }
+                        END_LOCK;
+                        if (! con)
+                                break;
+                        examined++;
+                        Mutex_unlock(P->mutex);
+                        bool alive = Connection_ping(con);
+                        Mutex_lock(P->mutex);
+                        if (! alive || P->stopped) {
+                                P->pending--;
+                                Mutex_unlock(P->mutex);
                                 Connection_free(&con);
-                                n++;
+                                Mutex_lock(P->mutex);
+                                if (! alive)
+                                        n++;
                                 i--;
+                                _signalCapacity(P);
+                        } else {
+                                P->pending--;
+                                Vector_push(P->pool, con);
+                                LOCK(shard->mutex)
+                                {
+                                        int size = Vector_size(shard->idle);
+                                        Vector_insert(shard->idle, i < size ? i : size, con);
+                                }
+                                END_LOCK;
                         }
-                } 
+                }
         }
+        // Close expired Connections
+        if (count > 0) {
+                Mutex_unlock(P->mutex);
+                for (int i = 0; i < count; i++)
+                        Connection_free(&expired[i]);
+                Mutex_lock(P->mutex);
+                P->pending -= count;
+                _signalCapacity(P);
+        }
+        _stats(P)->reaped += n; // add is atomic
         return n;
 }
 
 
+/* Reap idle Connections down to initialConnections and minIdle. P->mutex must be locked */
+static int _reapConnections(T P) {
+        int idle = Vector_size(P->pool) - P->active;
+        int x = idle - P->initialConnections;
+        if (x > idle - P->minIdle)
+                x = idle - P->minIdle;
+        return _closeIdle(P, x, Time_now() - P->connectionTimeout);
+}
+
+
+/* Adaptive sizing, run by the reaper at each sweep. The number of Connections
+ needed is estimated with Little's law as checkout rate * mean hold time, and 
+ the pool is sized so that this is targetUtilization percent of the pool. If
+ callers had to wait, the pool grows by at least one Connection (additive 
+ increase). Otherwise, surplus idle Connections are closed, at most a quarter
+ of the pool per sweep (multiplicative decrease). The pool is kept between 
+ initialConnections and maxConnections. P->mutex must be locked */
+static void _adapt(T P) {
+        Statistics_T now = ConnectionPool_getStatistics(P);
+        long long millis = Time_milli();
+        long long elapsed = millis - P->adaptTime;
+        if (P->adaptTime && elapsed > 0) {
+                long long checkouts = now.checkouts - P->adaptStats.checkouts;
+                long long returns = 0;
+                for (int b = 0; b < LIBZDB_HISTOGRAM_BUCKETS; b++)
+                        returns += now.holdTime[b] - P->adaptStats.holdTime[b];
+                double rate = checkouts * (double)MSEC_PER_SEC / elapsed;
+                double hold = returns ? (now.holdTimeSum - P->adaptStats.holdTimeSum) / (double)returns / USEC_PER_SEC : 0;
+                double needed = rate * hold * 100 / P->targetUtilization;
+                int target = (int)needed;
+                if (target < needed)
+                        target++;
+                int size = Vector_size(P->pool);
+                bool waited = (now.timeouts > P->adaptStats.timeouts) ||
+                              (checkouts && (now.waitTimeSum - P->adaptStats.waitTimeSum) / checkouts > SQL_ADAPTIVE_MAX_WAIT);
+                if (waited && target <= size)
+                        target = size + 1;
+                if (target < P->initialConnections)
+                        target = P->initialConnections;
+                if (target < P->minIdle)
+                        target = P->minIdle;
+                if (target > P->maxConnections)
+                        target = P->maxConnections;
+                DEBUG("Adaptive pool: rate %.1f/s, hold %.3fs, size %d, target %d\n", rate, hold, size, target);
+                if (target > size) {
+                        for (int i = size; i < target && ! P->stopped && _hasCapacity(P); i++)
+                                if (! _build(P))
+                                        break;
+                } else if (target < size) {
+                        int x = size - target;
+                        if (x > (size + 3) / 4)
+                                x = (size + 3) / 4;
+                        _closeIdle(P, x, Time_now() + 1);
+                }
+        }
+        P->adaptStats = now;
+        P->adaptTime = millis;
+}
+
+
+/* Returns the lowest measured latency of hosts not ejected or LLONG_MAX if none */
+static long long _fastestHost(T P, long long now) {
+        long long fastest = LLONG_MAX;
+        for (int i = 0; i < P->hostCount; i++) {
+                host_t h = &P->hosts[i];
+                if (h->ejected <= now && h->latency && h->latency < fastest)
+                        fastest = h->latency;
+        }
+        return fastest;
+}
+
+
+/* Returns true if the host is not ejected and not much slower than the fastest host */
+static inline bool _isUsableHost(T P, int host, long long now, long long fastest) {
+        host_t h = &P->hosts[host];
+        if (h->ejected > now)
+                return false;
+        return (h->latency <= SQL_HOST_OUTLIER_LATENCY || fastest == LLONG_MAX || h->latency <= SQL_HOST_OUTLIER_FACTOR * fastest);
+}
+
+
+/* Close one idle Connection to a host which is ejected or a slow outlier, so
+ Connections move gradually to the other hosts as they are reopened. P->mutex
+ must be locked */
+static void _drainHosts(T P) {
+        long long now = Time_micro();
+        long long fastest = _fastestHost(P, now);
+        if (fastest == LLONG_MAX)
+                return; // No host to move to
+        Connection_T con = NULL;
+        for (int s = 0; s < P->shardCount && ! con; s++) {
+                shard_t shard = &P->shards[s];
+                LOCK(shard->mutex)
+                {
+                        for (int i = 0; i < Vector_size(shard->idle); i++) {
+                                Connection_T c = Vector_get(shard->idle, i);
+                                if (! _isUsableHost(P, Connection_getHostIndex(c), now, fastest)) {
+                                        con = Vector_remove(shard->idle, i);
+                                        _detach(P, con);
+                                        break;
+                                }
+                        }
+                }
+                END_LOCK;
+        }
+        if (con) {
+                DEBUG("Draining connection to %s\n", Connection_getHost(con));
+                Mutex_unlock(P->mutex);
+                Connection_free(&con);
+                Mutex_lock(P->mutex);
+                P->pending--;
+                _stats(P)->reaped++; // increment is atomic
+                _signalCapacity(P);
+        }
+}
+
+
+/* Report Connections checked out longer than leakThreshold, once per 
+ check-out. With leakReclaim, a leaked Connection is taken out of the pool 
+ and closed when the holder returns it. The handler is called with P->mutex
+ unlocked. P->mutex must be locked */
+static void _detectLeaks(T P) {
+        int n = 0;
+        struct {const char *tag; long long held;} leaks[SQL_MAX_REAP_BATCH];
+        long long now = Time_micro();
+        for (int i = 0; (i < Vector_size(P->pool)) && (n < SQL_MAX_REAP_BATCH); i++) {
+                Connection_T con = Vector_get(P->pool, i);
+                if (Connection_isAvailable(con))
+                        continue;
+                long long held = now - Connection_getLastAccessedMicro(con);
+                if (held < P->leakThreshold * 1000LL)
+                        continue;
+                if (P->leakReclaim) {
+                        if (! Connection_release(con))
+                                continue; // The holder is returning it
+                        Vector_remove(P->pool, i--);
+                        P->active--; // decrement is atomic
+                        P->classes[Connection_getPriority(con)].active--; // decrement is atomic
+                        _signalCapacity(P);
+                } else if (! Connection_markLeaked(con)) {
+                        continue; // Already reported
+                }
+                leaks[n].tag = Connection_getTag(con);
+                leaks[n].held = held / 1000;
+                n++;
+        }
+        if (n > 0) {
+                _stats(P)->leaks += n; // add is atomic
+                Mutex_unlock(P->mutex);
+                for (int i = 0; i < n; i++) {
+                        DEBUG("Connection leaked by %s, held for %lld ms\n", leaks[i].tag ? leaks[i].tag : "?", leaks[i].held);
+                        if (P->leakHandler)
+                                P->leakHandler(leaks[i].tag, leaks[i].held);
+                }
+                Mutex_lock(P->mutex);
+        }
+}
+
+
+/* Start a replica pool with the primary pool's settings */
+static void _startReplica(T P, replica_t r) {
+        r->pool->initialConnections = P->initialConnections;
+        r->pool->maxConnections = P->maxConnections;
+        r->pool->connectionTimeout = P->connectionTimeout;
+        r->pool->validation = P->validation;
+        r->pool->validationIdleTime = P->validationIdleTime;
+        r->pool->doSweep = P->doSweep;
+        r->pool->sweepInterval = P->sweepInterval;
+        r->pool->initializer = P->initializer;
+        r->pool->leakThreshold = P->leakThreshold;
+        r->pool->leakHandler = P->leakHandler;
+        r->pool->leakReclaim = P->leakReclaim;
+        r->pool->doReset = P->doReset;
+        r->pool->statementCacheSize = P->statementCacheSize;
+        r->pool->statementCacheMemory = P->statementCacheMemory;
+        r->pool->batchRewrite = P->batchRewrite;
+        r->pool->breaker.threshold = P->breaker.threshold;
+        r->pool->breaker.maxBackoff = P->breaker.maxBackoff;
+        ConnectionPool_setInitSQL(r->pool, P->initSQL);
+        if (Vector_isEmpty(r->pool->statements))
+                for (int i = 0; i < Vector_size(P->statements); i++)
+                        ConnectionPool_addPreparedStatement(r->pool, Vector_get(P->statements, i));
+        TRY
+        {
+                ConnectionPool_start(r->pool);
+                r->healthy = true;
+        }
+        ELSE
+        {
+                DEBUG("Failed to start replica %s -- %s\n", URL_toString(r->pool->url), Exception_frame.message);
+                r->healthy = false;
+        }
+        END_TRY;
+}
+
+
+/* Measure latency and replication lag of each replica. A replica is not used
+ while it is unreachable or lags behind more than maxReplicationLag. P->mutex 
+ must be unlocked */
+static void _checkReplicas(T P) {
+        for (int i = 0; i < Vector_size(P->replicas) && ! P->stopped; i++) {
+                replica_t r = Vector_get(P->replicas, i);
+                if (! r->pool->filled)
+                        _startReplica(P, r);
+                volatile bool healthy = false;
+                Connection_T con = r->pool->filled ? ConnectionPool_getConnection(r->pool) : NULL;
+                if (con) {
+                        TRY
+                        {
+                                long long start = Time_micro();
+                                if (Connection_ping(con)) {
+                                        long long lag = Connection_getReplicationLag(con);
+                                        long long latency = Time_micro() - start;
+                                        // Moving average where the new sample weighs 1/4
+                                        r->latency = r->latency ? (3 * r->latency + latency) / 4 : latency;
+                                        r->lag = lag;
+                                        // Unknown lag (-1) is accepted
+                                        healthy = (lag <= P->maxReplicationLag);
+                                }
+                        }
+                        ELSE
+                        {
+                                DEBUG("Replica %s failed health check -- %s\n", URL_toString(r->pool->url), Exception_frame.message);
+                        }
+                        END_TRY;
+                        Connection_close(con);
+                }
+                r->healthy = healthy;
+        }
+}
+
+
+/* The reaper thread. It is also started without ConnectionPool_setReaper()
+ if the pool has replicas, but then only checks the replicas */
 static void *_doSweep(void *args) {
         T P = args;
         struct timespec wait = {};
         Mutex_lock(P->mutex);
         while (! P->stopped) {
-                wait.tv_sec = Time_now() + P->sweepInterval;
+                wait.tv_sec = Time_now() + (P->doSweep ? P->sweepInterval : SQL_DEFAULT_SWEEP_INTERVAL);
                 Sem_timeWait(P->alarm,  P->mutex, wait);
                 if (P->stopped) break;
-                _reapConnections(P);
+                if (P->doSweep) {
+                        _reapConnections(P);
+                        if (P->hostCount > 1)
+                                _drainHosts(P);
+                        if (P->leakThreshold)
+                                _detectLeaks(P);
+                        if (P->targetUtilization)
+                                _adapt(P);
+                }
+                bool keepAlive = (P->doSweep && P->validation == Validation_background);
+                if (keepAlive || ! Vector_isEmpty(P->replicas)) {
+                        Mutex_unlock(P->mutex);
+                        if (keepAlive)
+                                _keepAlive(P);
+                        _checkReplicas(P);
+                        Mutex_lock(P->mutex);
+                }
         }
         Mutex_unlock(P->mutex);
         DEBUG("Reaper thread stopped\n");
@@ -147,6 +1060,289 @@ static void *_doSweep(void *args) {
 }
 
 
+/* Make a returned Connection idle, handing it directly to a waiter if any */
+static void _release(T P, Connection_T connection) {
+        if (P->waiting > 0) {
+                POOL_LOCK(P)
+                {
+                        if (_handoff(P, connection))
+                                connection = NULL;
+                }
+                POOL_END_LOCK(P);
+                if (! connection)
+                        return;
+        }
+        _pushShard(_getShard(P), connection);
+        // Catch a waiter which was queued after we checked above
+        if (P->waiting > 0) {
+                POOL_LOCK(P)
+                {
+                        _dispatch(P);
+                }
+                POOL_END_LOCK(P);
+        }
+}
+
+
+/* Reset returned Connections off the caller's thread. A session is only
+ reset on the server if the pool does not set up sessions, as that would 
+ undo init SQL and invalidate pre-prepared statements */
+static void *_doReset(void *args) {
+        T P = args;
+        Mutex_lock(P->resetMutex);
+        while (! P->stopped) {
+                if (Vector_isEmpty(P->resets)) {
+                        Sem_wait(P->reset, P->resetMutex);
+                        continue;
+                }
+                Connection_T con = Vector_pop(P->resets);
+                Mutex_unlock(P->resetMutex);
+                bool discard = ! (P->initSQL || P->initializer || ! Vector_isEmpty(P->statements) || P->statementCacheSize);
+                if (Connection_reset(con, discard)) {
+                        _release(P, con);
+                } else {
+                        LOCK(P->mutex)
+                        {
+                                _removeConnection(P, con);
+                        }
+                        END_LOCK;
+                }
+                Mutex_lock(P->resetMutex);
+        }
+        Mutex_unlock(P->resetMutex);
+        DEBUG("Reset thread stopped\n");
+        return NULL;
+}
+
+
+/* Returns true if the builder should add a Connection. P->mutex must be locked */
+static inline bool _needBuild(T P) {
+        int idle = Vector_size(P->pool) - P->active;
+        return _hasCapacity(P) && ((idle < P->minIdle) || P->waiting > 0);
+}
+
+
+/* Keep minIdle Connections in the pool and serve waiters. Connections are
+ opened outside the pool mutex and added once they are established */
+static void *_doBuild(void *args) {
+        T P = args;
+        struct timespec wait = {};
+        Mutex_lock(P->mutex);
+        while (! P->stopped) {
+                bool failed = false;
+                while (! P->stopped && ! failed && _needBuild(P))
+                        failed = ! _build(P);
+                if (P->stopped) break;
+                // Retry a failed connect after a second, otherwise sleep until signaled
+                wait.tv_sec = Time_now() + (failed ? 1 : SQL_DEFAULT_SWEEP_INTERVAL);
+                Sem_timeWait(P->build, P->mutex, wait);
+        }
+        Mutex_unlock(P->mutex);
+        DEBUG("Builder thread stopped\n");
+        return NULL;
+}
+
+
+/* Get an idle Connection or, if there is no builder, create one. Returns 
+ NULL if the priority class cannot be admitted */
+static Connection_T _getConnection(T P, int c) {
+        Connection_T con;
+        class_t k = &P->classes[c];
+        if (P->limited) {
+                bool admitted;
+                // Admit and count the check-out in one step so concurrent callers cannot exceed the class limit
+                POOL_LOCK(P)
+                {
+                        if ((admitted = _isAdmissible(P, c)))
+                                k->active++;
+                }
+                POOL_END_LOCK(P);
+                if (! admitted)
+                        return NULL;
+        } else {
+                k->active++; // increment is atomic
+        }
+        while ((con = _checkout(P))) {
+                if (_validate(P, con))
+                        goto done;
+                POOL_LOCK(P)
+                {
+                        _removeConnection(P, con);
+                }
+                POOL_END_LOCK(P);
+        }
+        if (P->builder) {
+                POOL_LOCK(P)
+                {
+                        if (_needBuild(P))
+                                Sem_signal(P->build);
+                }
+                POOL_END_LOCK(P);
+                k->active--; // decrement is atomic
+                return NULL;
+        }
+	POOL_LOCK(P) 
+        {
+                con = _newConnection(P);
+        }
+        POOL_END_LOCK(P);
+        if (! con) {
+                k->active--; // decrement is atomic
+                return NULL;
+        }
+done: 
+        Connection_setAvailable(con, false);
+        Connection_setPriority(con, c);
+        P->active++; // increment is atomic
+        if (P->builder && (Vector_size(P->pool) - P->active < P->minIdle)) {
+                POOL_LOCK(P)
+                {
+                        Sem_signal(P->build);
+                }
+                POOL_END_LOCK(P);
+        }
+	return con;
+}
+
+
+/* Wait up to ms milliseconds to be handed a Connection. Fail fast if the
+ wait queue of the priority class is full */
+static Connection_T _await(T P, int ms, int c) {
+        struct waiter_t w = {.priority = c};
+        class_t k = &P->classes[c];
+        long long deadline = Time_milli() + ms;
+        struct timespec wait = {.tv_sec = deadline / MSEC_PER_SEC, .tv_nsec = (deadline % MSEC_PER_SEC) * USEC_PER_SEC};
+        Sem_init(w.cond);
+        LOCK(P->mutex)
+        {
+                if (k->maxWaiting && k->waiting >= k->maxWaiting) {
+                        _stats(P)->shed++; // increment is atomic
+                } else {
+                        _enqueue(P, &w);
+                        // A Connection may have been returned before we were queued
+                        _dispatch(P);
+                        if (P->builder && ! w.con)
+                                Sem_signal(P->build);
+                        while (! w.con && ! P->stopped && Time_milli() < deadline) {
+                                // Open a Connection if there is capacity and this waiter is served next
+                                if (! P->builder && _hasCapacity(P) && k->head == &w && _nextClass(P) == c) {
+                                        Connection_T con = _newConnection(P);
+                                        if (con) {
+                                                _handoff(P, con);
+                                                _signalCapacity(P);
+                                                break;
+                                        }
+                                }
+                                Sem_timeWait(w.cond, P->mutex, wait);
+                        }
+                        _dequeue(P, &w); // No-op if we were handed a Connection
+                }
+        }
+        END_LOCK;
+        Sem_destroy(w.cond);
+        if (w.con) {
+                Connection_setAvailable(w.con, false);
+                Connection_setPriority(w.con, c);
+        }
+        return w.con;
+}
+
+
+/* Get a Connection, waiting up to ms milliseconds if none is available */
+static Connection_T _get(T P, int ms, int c) {
+        long long start = Time_micro();
+        Connection_T con = _getConnection(P, c);
+        if (! con && ms > 0 && ! P->stopped)
+                con = _await(P, ms, c);
+        struct counters_t *stats = _stats(P);
+        if (con) {
+                stats->checkouts++; // increment is atomic
+                _record(stats->waitTime, &stats->waitTimeSum, Connection_getLastAccessedMicro(con) - start);
+        } else {
+                stats->timeouts++; // increment is atomic
+        }
+        return con;
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+int ConnectionPool_selectHost(T P) {
+        assert(P);
+        if (P->hostCount < 2)
+                return 0;
+        int best = -1;
+        long long now = Time_micro();
+        long long fastest = _fastestHost(P, now);
+        uint32_t ticket = P->hostTicket++; // increment is atomic
+        for (int i = 0, candidates = 0; (i < P->hostCount) && (candidates < 2); i++) {
+                int h = (ticket + i) % P->hostCount;
+                if (_isUsableHost(P, h, now, fastest)) {
+                        candidates++;
+                        if (best < 0 || P->hosts[h].latency < P->hosts[best].latency)
+                                best = h;
+                }
+        }
+        if (best < 0) {
+                // Every host is ejected, use the one which was ejected first
+                best = ticket % P->hostCount;
+                for (int h = 0; h < P->hostCount; h++)
+                        if (P->hosts[h].ejected < P->hosts[best].ejected)
+                                best = h;
+        }
+        return best;
+}
+
+
+void ConnectionPool_reportHost(T P, int host, long long latency, bool ok) {
+        assert(P);
+        if (P->hostCount < 2)
+                return;
+        assert(host >= 0 && host < P->hostCount);
+        host_t h = &P->hosts[host];
+        if (ok) {
+                if (latency < 1)
+                        latency = 1; // 0 means not measured
+                // Moving average where the new sample weighs 1/4
+                h->latency = h->latency ? (3 * h->latency + latency) / 4 : latency;
+                h->failures = 0;
+                h->ejected = 0;
+        } else {
+                int failures = ++h->failures; // increment is atomic
+                long long backoff = SQL_HOST_BACKOFF;
+                for (int i = 1; i < failures && backoff < SQL_HOST_MAX_BACKOFF; i++)
+                        backoff *= 2;
+                if (backoff > SQL_HOST_MAX_BACKOFF)
+                        backoff = SQL_HOST_MAX_BACKOFF;
+                h->ejected = Time_micro() + backoff * 1000;
+                DEBUG("Host %s ejected for %lld ms\n", URL_getHostAt(P->url, host), backoff);
+        }
+}
+
+
+void ConnectionPool_initConnection(T P, Connection_T connection) {
+        assert(P);
+        assert(connection);
+        if (P->initSQL)
+                Connection_execute(connection, "%s", P->initSQL);
+        if (P->initializer)
+                P->initializer(connection);
+        for (int i = 0; i < Vector_size(P->statements); i++)
+                Connection_addPreparedStatement(connection, Vector_get(P->statements, i));
+}
+
+
+void ConnectionPool_reportStatement(T P, bool hit) {
+        assert(P);
+        struct counters_t *stats = _stats(P);
+        if (hit)
+                stats->statementHits++; // increment is atomic
+        else
+                stats->statementMisses++; // increment is atomic
+}
+
+
 /* ---------------------------------------------------------------- Public */
 
 
@@ -154,14 +1350,38 @@ T ConnectionPool_new(URL_T url) {
         T P;
 	assert(url);
         System_init();
+        Thread_once(once_control, _init_once);
 	NEW(P);
         P->url = url;
         Sem_init(P->alarm);
+        Sem_init(P->build);
+        Sem_init(P->reset);
 	Mutex_init(P->mutex);
+        Mutex_init(P->resetMutex);
 	P->maxConnections = SQL_DEFAULT_MAX_CONNECTIONS;
         P->pool = Vector_new(SQL_DEFAULT_MAX_CONNECTIONS);
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        P->shardCount = (cpus < 1) ? 1 : (cpus > SQL_MAX_POOL_SHARDS) ? SQL_MAX_POOL_SHARDS : (int)cpus;
+        P->shards = CALLOC(P->shardCount, sizeof(struct shard_t));
+        for (int i = 0; i < P->shardCount; i++) {
+                Mutex_init(P->shards[i].mutex);
+                P->shards[i].idle = Vector_new(SQL_DEFAULT_MAX_CONNECTIONS / P->shardCount + 1);
+        }
 	P->initialConnections = SQL_DEFAULT_INIT_CONNECTIONS;
         P->connectionTimeout = SQL_DEFAULT_CONNECTION_TIMEOUT;
+        P->validation = Validation_idle;
+        P->statementCacheMemory = SQL_DEFAULT_STATEMENT_CACHE_MEMORY;
+        P->breaker.threshold = SQL_BREAKER_FAILURES;
+        P->breaker.maxBackoff = SQL_BREAKER_MAX_BACKOFF;
+        P->hostCount = URL_getHostCount(url);
+        if (P->hostCount > 1)
+                P->hosts = CALLOC(P->hostCount, sizeof(struct host_t));
+        for (int c = 0; c < LIBZDB_PRIORITY_CLASSES; c++)
+                P->classes[c].weight = 1 << (LIBZDB_PRIORITY_CLASSES - 1 - c); // 4, 2, 1
+        P->statements = Vector_new(4);
+        P->replicas = Vector_new(4);
+        P->resets = Vector_new(SQL_DEFAULT_MAX_CONNECTIONS);
+        P->maxReplicationLag = SQL_DEFAULT_MAX_REPLICATION_LAG;
 	return P;
 }
 
@@ -173,8 +1393,30 @@ void ConnectionPool_free(T *P) {
         if (! (*P)->stopped)
                 ConnectionPool_stop((*P));
         Vector_free(&pool);
+        while (! Vector_isEmpty((*P)->replicas)) {
+                replica_t r = Vector_pop((*P)->replicas);
+                ConnectionPool_free(&r->pool);
+                FREE(r);
+        }
+        Vector_free(&(*P)->replicas);
+        while (! Vector_isEmpty((*P)->statements)) {
+                char *sql = Vector_pop((*P)->statements);
+                FREE(sql);
+        }
+        Vector_free(&(*P)->statements);
+        Vector_free(&(*P)->resets);
+        FREE((*P)->initSQL);
+        for (int i = 0; i < (*P)->shardCount; i++) {
+                Vector_free(&(*P)->shards[i].idle);
+                Mutex_destroy((*P)->shards[i].mutex);
+        }
+        FREE((*P)->shards);
+        FREE((*P)->hosts);
 	Mutex_destroy((*P)->mutex);
+        Mutex_destroy((*P)->resetMutex);
         Sem_destroy((*P)->alarm);
+        Sem_destroy((*P)->build);
+        Sem_destroy((*P)->reset);
         FREE((*P)->error);
 	FREE(*P);
 }
@@ -223,6 +1465,83 @@ int ConnectionPool_getMaxConnections(T P) {
 }
 
 
+void ConnectionPool_setMinIdle(T P, int minIdle) {
+        assert(P);
+        assert(minIdle >= 0);
+        LOCK(P->mutex)
+        {
+                P->minIdle = minIdle;
+                P->doBuild = (minIdle > 0);
+                if (P->doBuild && P->builder)
+                        Sem_signal(P->build);
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getMinIdle(T P) {
+        assert(P);
+        return P->minIdle;
+}
+
+
+void ConnectionPool_setTargetUtilization(T P, int percent) {
+        assert(P);
+        assert(percent >= 0 && percent <= 100);
+        LOCK(P->mutex)
+        {
+                P->targetUtilization = percent;
+                P->adaptTime = 0;
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_getTargetUtilization(T P) {
+        assert(P);
+        return P->targetUtilization;
+}
+
+
+void ConnectionPool_addReplica(T P, URL_T url) {
+        assert(P);
+        assert(url);
+        replica_t r;
+        NEW(r);
+        r->pool = ConnectionPool_new(url);
+        r->healthy = true;
+        LOCK(P->mutex)
+        {
+                Vector_push(P->replicas, r);
+                // Replica health is measured by the reaper, start it if the pool is running without one
+                if (P->filled && ! P->reaper) {
+                        DEBUG("Starting Database reaper thread\n");
+                        Thread_create(P->reaper, _doSweep, P);
+                }
+        }
+        END_LOCK;
+}
+
+
+int ConnectionPool_replicas(T P) {
+        assert(P);
+        return Vector_size(P->replicas);
+}
+
+
+void ConnectionPool_setMaxReplicationLag(T P, int ms) {
+        assert(P);
+        assert(ms >= 0);
+        P->maxReplicationLag = ms;
+}
+
+
+int ConnectionPool_getMaxReplicationLag(T P) {
+        assert(P);
+        return P->maxReplicationLag;
+}
+
+
 void ConnectionPool_setConnectionTimeout(T P, int connectionTimeout) {
         assert(P);
         assert(connectionTimeout > 0);
@@ -242,6 +1561,168 @@ void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error))
 }
 
 
+void ConnectionPool_setConnectionInitializer(T P, void(*initializer)(Connection_T connection)) {
+        assert(P);
+        P->initializer = initializer;
+}
+
+
+void ConnectionPool_setInitSQL(T P, const char *sql) {
+        assert(P);
+        FREE(P->initSQL);
+        P->initSQL = Str_dup(sql);
+}
+
+
+const char *ConnectionPool_getInitSQL(T P) {
+        assert(P);
+        return P->initSQL;
+}
+
+
+void ConnectionPool_addPreparedStatement(T P, const char *sql) {
+        assert(P);
+        assert(sql);
+        LOCK(P->mutex)
+        {
+                Vector_push(P->statements, Str_dup(sql));
+        }
+        END_LOCK;
+}
+
+
+void ConnectionPool_setLeakDetection(T P, int threshold, void(*leakHandler)(const char *tag, long long heldTime)) {
+        assert(P);
+        assert(threshold >= 0);
+        P->leakThreshold = threshold;
+        P->leakHandler = leakHandler;
+}
+
+
+int ConnectionPool_getLeakThreshold(T P) {
+        assert(P);
+        return P->leakThreshold;
+}
+
+
+void ConnectionPool_setLeakReclaim(T P, bool reclaim) {
+        assert(P);
+        P->leakReclaim = reclaim;
+}
+
+
+void ConnectionPool_setPriorityLimits(T P, Priority_T priority, int reserved, int limit) {
+        assert(P);
+        assert(priority >= 0 && priority < LIBZDB_PRIORITY_CLASSES);
+        assert(reserved >= 0);
+        assert(limit >= 0);
+        LOCK(P->mutex)
+        {
+                P->classes[priority].reserved = reserved;
+                P->classes[priority].limit = limit;
+                P->limited = false;
+                for (int c = 0; c < LIBZDB_PRIORITY_CLASSES; c++)
+                        if (P->classes[c].reserved || P->classes[c].limit)
+                                P->limited = true;
+        }
+        END_LOCK;
+}
+
+
+void ConnectionPool_setPriorityQueue(T P, Priority_T priority, int weight, int maxWaiting) {
+        assert(P);
+        assert(priority >= 0 && priority < LIBZDB_PRIORITY_CLASSES);
+        assert(weight > 0);
+        assert(maxWaiting >= 0);
+        LOCK(P->mutex)
+        {
+                P->classes[priority].weight = weight;
+                P->classes[priority].maxWaiting = maxWaiting;
+        }
+        END_LOCK;
+}
+
+
+void ConnectionPool_setStatementCache(T P, int size, int memory) {
+        assert(P);
+        assert(size >= 0);
+        assert(memory >= 0);
+        P->statementCacheSize = size;
+        P->statementCacheMemory = memory;
+}
+
+
+int ConnectionPool_getStatementCacheSize(T P) {
+        assert(P);
+        return P->statementCacheSize;
+}
+
+
+int ConnectionPool_getStatementCacheMemory(T P) {
+        assert(P);
+        return P->statementCacheMemory;
+}
+
+
+void ConnectionPool_setBatchRewrite(T P, bool rewrite) {
+        assert(P);
+        P->batchRewrite = rewrite;
+}
+
+
+bool ConnectionPool_getBatchRewrite(T P) {
+        assert(P);
+        return P->batchRewrite;
+}
+
+
+void ConnectionPool_setDeferredReset(T P, bool deferred) {
+        assert(P);
+        P->doReset = deferred;
+}
+
+
+bool ConnectionPool_getDeferredReset(T P) {
+        assert(P);
+        return P->doReset;
+}
+
+
+void ConnectionPool_setCircuitBreaker(T P, int failures, int maxBackoff) {
+        assert(P);
+        assert(failures >= 0);
+        assert(maxBackoff > 0);
+        LOCK(P->mutex)
+        {
+                P->breaker.threshold = failures;
+                P->breaker.maxBackoff = maxBackoff;
+                if (! failures)
+                        P->breaker.state = Circuit_closed;
+        }
+        END_LOCK;
+}
+
+
+Circuit_T ConnectionPool_getCircuitState(T P) {
+        assert(P);
+        return P->breaker.state;
+}
+
+
+void ConnectionPool_setValidation(T P, Validation_T policy, int idleTime) {
+        assert(P);
+        assert(idleTime >= 0);
+        P->validation = policy;
+        P->validationIdleTime = idleTime;
+}
+
+
+Validation_T ConnectionPool_getValidation(T P) {
+        assert(P);
+        return P->validation;
+}
+
+
 void ConnectionPool_setReaper(T P, int sweepInterval) {
         assert(P);
         assert(sweepInterval>0);
@@ -261,13 +1742,89 @@ int ConnectionPool_size(T P) {
 
 
 int ConnectionPool_active(T P) {
-        int n = 0;
         assert(P);
-        LOCK(P->mutex)
-        {
-                n = _getActive(P);
+        return P->active;
+}
+
+
+Statistics_T ConnectionPool_getStatistics(T P) {
+        assert(P);
+        Statistics_T s = {
+                .size = Vector_size(P->pool),
+                .active = P->active,
+                .waiting = P->waiting
+        };
+        for (int i = 0; i < P->shardCount; i++) {
+                struct counters_t *c = &P->shards[i].stats;
+                s.checkouts += c->checkouts;
+                s.timeouts += c->timeouts;
+                s.creations += c->creations;
+                s.failures += c->failures;
+                s.reaped += c->reaped;
+                s.leaks += c->leaks;
+                s.shed += c->shed;
+                s.trips += c->trips;
+                s.statementHits += c->statementHits;
+                s.statementMisses += c->statementMisses;
+                s.checkoutLockTime += c->checkoutLockTime;
+                s.waitTimeSum += c->waitTimeSum;
+                s.holdTimeSum += c->holdTimeSum;
+                for (int b = 0; b < LIBZDB_HISTOGRAM_BUCKETS; b++) {
+                        s.waitTime[b] += c->waitTime[b];
+                        s.holdTime[b] += c->holdTime[b];
+                }
         }
-        END_LOCK;
+        return s;
+}
+
+
+int ConnectionPool_formatStatistics(Statistics_T *stats, const char *name, char *buf, int size) {
+        assert(stats);
+        assert(name);
+        assert(buf || size == 0);
+        int n = 0;
+        // Append to buf and keep counting the required length if buf is full
+#define PRINT(...) do { \
+        int _x = snprintf(n < size ? buf + n : NULL, n < size ? size - n : 0, __VA_ARGS__); \
+        if (_x > 0) n += _x; \
+} while (0)
+        struct {const char *metric; const char *type; const char *help; double value;} m[] = {
+                {"checkouts_total", "counter", "Connections handed out", stats->checkouts},
+                {"timeouts_total", "counter", "Requests for a connection which returned none", stats->timeouts},
+                {"creations_total", "counter", "Connections opened", stats->creations},
+                {"failures_total", "counter", "Failed attempts to open a connection", stats->failures},
+                {"reaped_total", "counter", "Connections closed by the reaper", stats->reaped},
+                {"leaks_total", "counter", "Connections held longer than the leak threshold", stats->leaks},
+                {"shed_total", "counter", "Requests rejected because the wait queue was full", stats->shed},
+                {"circuit_trips_total", "counter", "Times the circuit breaker opened", stats->trips},
+                {"statement_cache_hits_total", "counter", "Prepared statements found in the statement cache", stats->statementHits},
+                {"statement_cache_misses_total", "counter", "Prepared statements which had to be prepared", stats->statementMisses},
+                {"checkout_lock_seconds_total", "counter", "Time the pool mutex was held by connection check-out and return", stats->checkoutLockTime / (double)USEC_PER_SEC},
+                {"size", "gauge", "Connections in the pool", stats->size},
+                {"active", "gauge", "Connections in use", stats->active},
+                {"waiting", "gauge", "Threads waiting for a connection", stats->waiting}
+        };
+        for (int i = 0; i < (int)(sizeof(m) / sizeof(m[0])); i++) {
+                PRINT("# HELP libzdb_pool_%s %s\n# TYPE libzdb_pool_%s %s\n", m[i].metric, m[i].help, m[i].metric, m[i].type);
+                PRINT("libzdb_pool_%s{pool=\"%s\"} %.15g\n", m[i].metric, name, m[i].value);
+        }
+        struct {const char *metric; const char *help; long long *buckets; long long sum;} h[] = {
+                {"wait_seconds", "Time to obtain a connection", stats->waitTime, stats->waitTimeSum},
+                {"hold_seconds", "Time a connection was in use", stats->holdTime, stats->holdTimeSum}
+        };
+        for (int i = 0; i < (int)(sizeof(h) / sizeof(h[0])); i++) {
+                long long count = 0;
+                PRINT("# HELP libzdb_pool_%s %s\n# TYPE libzdb_pool_%s histogram\n", h[i].metric, h[i].help, h[i].metric);
+                for (int b = 0; b < LIBZDB_HISTOGRAM_BUCKETS - 1; b++) {
+                        count += h[i].buckets[b];
+                        PRINT("libzdb_pool_%s_bucket{pool=\"%s\",le=\"%.15g\"} %lld\n", h[i].metric, name, (double)(1LL << b) / USEC_PER_SEC, count);
+                }
+                count += h[i].buckets[LIBZDB_HISTOGRAM_BUCKETS - 1];
+                PRINT("libzdb_pool_%s_bucket{pool=\"%s\",le=\"+Inf\"} %lld\n", h[i].metric, name, count);
+                PRINT("libzdb_pool_%s_sum{pool=\"%s\"} %.15g\n", h[i].metric, name, h[i].sum / (double)USEC_PER_SEC);
+                PRINT("libzdb_pool_%s_count{pool=\"%s\"} %lld\n", h[i].metric, name, count);
+        }
+#undef PRINT
         return n;
 }
 
@@ -283,29 +1840,59 @@ void ConnectionPool_start(T P) {
                 if (! P->filled) {
                         P->filled = _fillPool(P);
                         if (P->filled) {
-                                if (P->doSweep) {
+                                if (P->doSweep || ! Vector_isEmpty(P->replicas)) {
                                         DEBUG("Starting Database reaper thread\n");
                                         Thread_create(P->reaper, _doSweep, P);
                                 }
+                                if (P->doBuild) {
+                                        DEBUG("Starting Database builder thread\n");
+                                        Thread_create(P->builder, _doBuild, P);
+                                }
+                                if (P->doReset) {
+                                        DEBUG("Starting Database reset thread\n");
+                                        Thread_create(P->resetter, _doReset, P);
+                                }
                         }
                 }
         }
         END_LOCK;
         if (! P->filled)
                 THROW(SQLException, "Failed to start connection pool -- %s", P->error);
+        for (int i = 0; i < Vector_size(P->replicas); i++) {
+                replica_t r = Vector_get(P->replicas, i);
+                if (! r->pool->filled)
+                        _startReplica(P, r);
+        }
 }
 
 
 void ConnectionPool_stop(T P) {
         bool stopSweep = false;
+        bool stopBuild = false;
         assert(P);
+        // Stop the reset thread first so no Connection is in use by it when the pool is drained
+        if (P->resetter) {
+                DEBUG("Stopping Database reset thread...\n");
+                LOCK(P->resetMutex)
+                {
+                        P->stopped = true;
+                        Sem_signal(P->reset);
+                }
+                END_LOCK;
+                Thread_join(P->resetter);
+                P->resetter = 0;
+        }
         LOCK(P->mutex)
         {
                 P->stopped = true;
+                for (int c = 0; c < LIBZDB_PRIORITY_CLASSES; c++)
+                        for (waiter_t w = P->classes[c].head; w; w = w->next)
+                                Sem_signal(w->cond);
                 if (P->filled) {
                         _drainPool(P);
                         P->filled = false;
-                        stopSweep = (P->doSweep && P->reaper);
+                        stopSweep = (P->reaper != 0);
+                        stopBuild = (P->builder != 0);
                 }
         }
         END_LOCK;
@@ -313,59 +1900,107 @@ void ConnectionPool_stop(T P) {
                 DEBUG("Stopping Database reaper thread...\n");
                 Sem_signal(P->alarm);
                 Thread_join(P->reaper);
+                P->reaper = 0;
+        }
+        if (stopBuild) {
+                DEBUG("Stopping Database builder thread...\n");
+                Sem_signal(P->build);
+                Thread_join(P->builder);
+                P->builder = 0;
+        }
+        for (int i = 0; i < Vector_size(P->replicas); i++) {
+                replica_t r = Vector_get(P->replicas, i);
+                ConnectionPool_stop(r->pool);
         }
 }
 
 
 Connection_T ConnectionPool_getConnection(T P) {
-	Connection_T con = NULL;
 	assert(P);
-	LOCK(P->mutex) 
-        {
-                int size = Vector_size(P->pool);
-                for (int i = 0; i < size; i++) {
-                        con = Vector_get(P->pool, i);
-                        if (Connection_isAvailable(con)) {
-                                if (Connection_ping(con)) {
-                                        Connection_setAvailable(con, false);
-                                        goto done;
-                                }
-                        }
-                }
-                con = NULL;
-                if (size < P->maxConnections) {
-                        con = Connection_new(P, &P->error);
-                        if (con) {
-                                Connection_setAvailable(con, false);
-                                Vector_push(P->pool, con);
-                        } else {
-                                DEBUG("Failed to create connection -- %s\n", P->error);
-                                FREE(P->error);
-                        }
-                }
-        }
-done: 
-        END_LOCK;
-	return con;
+        return _get(P, 0, Priority_interactive);
+}
+
+
+Connection_T ConnectionPool_getConnectionWithTimeout(T P, int ms) {
+        assert(P);
+        assert(ms >= 0);
+        return _get(P, ms, Priority_interactive);
+}
+
+
+Connection_T ConnectionPool_getConnectionWithPriority(T P, Priority_T priority, int ms) {
+        assert(P);
+        assert(priority >= 0 && priority < LIBZDB_PRIORITY_CLASSES);
+        assert(ms >= 0);
+        return _get(P, ms, priority);
+}
+
+
+Connection_T ConnectionPool_getConnectionWithTag(T P, const char *tag) {
+        assert(P);
+        Connection_T con = _get(P, 0, Priority_interactive);
+        if (con)
+                Connection_setTag(con, tag);
+        return con;
 }
 
 
 void ConnectionPool_returnConnection(T P, Connection_T connection) {
 	assert(P);
         assert(connection);
-	if (Connection_isInTransaction(connection)) {
-                TRY
-                        Connection_rollback(connection);
-                ELSE
-                        DEBUG("Failed to rollback transaction -- %s\n", Exception_frame.message);
-                END_TRY;
-	}
-	Connection_clear(connection);
-	LOCK(P->mutex)
-        {
-		Connection_setAvailable(connection, true);
+        if (! Connection_release(connection)) {
+                // Reclaimed by the reaper as leaked and no longer in the pool
+                Connection_free(&connection);
+                return;
+        }
+        long long checkedOut = Connection_getLastAccessedMicro(connection);
+        bool deferred = P->resetter && Connection_needsReset(connection);
+        if (! deferred)
+                Connection_reset(connection, false);
+        Connection_setAvailable(connection, true);
+        P->classes[Connection_getPriority(connection)].active--; // decrement is atomic
+        P->active--; // decrement is atomic
+        struct counters_t *stats = _stats(P);
+        _record(stats->holdTime, &stats->holdTimeSum, Connection_getLastAccessedMicro(connection) - checkedOut);
+        if (deferred) {
+                // The reset thread makes the Connection idle once it is reset
+                LOCK(P->resetMutex)
+                {
+                        Vector_push(P->resets, connection);
+                        Sem_signal(P->reset);
+                }
+                END_LOCK;
+        } else {
+                _release(P, connection);
+        }
+}
+
+
+Connection_T ConnectionPool_getReadConnection(T P, const char *position) {
+        assert(P);
+        int n = Vector_size(P->replicas);
+        if (n > 0) {
+                replica_t best = NULL;
+                uint32_t ticket = P->readTicket++; // increment is atomic
+                // Of the next two healthy replicas in round-robin order, use the one with lowest latency
+                for (int i = 0, candidates = 0; (i < n) && (candidates < 2); i++) {
+                        replica_t r = Vector_get(P->replicas, (ticket + i) % n);
+                        if (r->healthy && r->pool->filled) {
+                                candidates++;
+                                if (! best || r->latency < best->latency)
+                                        best = r;
+                        }
+                }
+                if (best) {
+                        Connection_T con = ConnectionPool_getConnection(best->pool);
+                        if (con) {
+                                if (! position || Connection_hasReplayed(con, position))
+                                        return con;
+                                Connection_close(con);
+                        }
+                }
         }
-	END_LOCK;
+        return ConnectionPool_getConnection(P);
 }
 
 
@@ -44,8 +44,12 @@
  * connection from the pool. If there are no connections available a new
  * connection is created and returned. If the pool has already handed out
  * <i>maxConnections</i> Connections, the next call to 
- * ConnectionPool_getConnection() will return NULL. Use Connection_close()
- * to return a connection to the pool so it can be reused.
+ * ConnectionPool_getConnection() will return NULL. Use
+ * ConnectionPool_getConnectionWithTimeout() to instead wait for a
+ * connection to be returned. Use Connection_close() to return a connection
+ * to the pool so it can be reused. If a minimum number of idle connections
+ * is set with ConnectionPool_setMinIdle(), new connections are opened by a
+ * builder thread in the background and never on the calling thread.
  *
  * A connection pool is created default with 5 initial connections and 
  * with 20 maximum connections. These values can be changed by the property 
@@ -223,7 +227,145 @@
  * ConnectionPool_size() returns the number of connections in the pool, that is,
  * both active and inactive connections. The method ConnectionPool_active() 
  * returns the number of active connections, i.e. those connections in 
- * current use by your application. 
+ * current use by your application. Both methods are constant-time and 
+ * do not lock the pool. ConnectionPool_getStatistics() returns a snapshot
+ * of counters and latency histograms which can be written in Prometheus
+ * text format with ConnectionPool_formatStatistics().
+ *
+ * <h2 class="desc">Read replicas:</h2>
+ * Replica databases can be added with ConnectionPool_addReplica(). Use
+ * ConnectionPool_getReadConnection() to get a connection for read-only 
+ * work; it returns a connection to the replica with the lowest measured 
+ * latency, or to the primary if no replica is usable. A replica which
+ * lags behind the primary more than ConnectionPool_setMaxReplicationLag() is
+ * not used. To read your own writes, get the replication position with 
+ * Connection_getReplicationPosition() after the write and pass it to
+ * ConnectionPool_getReadConnection(). Replication lag and positions are 
+ * supported for PostgreSQL and MySQL.
+ * <pre>
+ * Connection_T con = ConnectionPool_getConnection(pool);
+ * Connection_execute(con, "update employee set salary = 1000 where id = 1");
+ * char *position = Str_dup(Connection_getReplicationPosition(con));
+ * Connection_close(con);
+ * con = ConnectionPool_getReadConnection(pool, position);
+ * // con sees the update above
+ * </pre>
+ *
+ * <h2 class="desc">Priority classes:</h2>
+ * Connections can be requested in one of three priority classes, 
+ * interactive, batch and background, with 
+ * ConnectionPool_getConnectionWithPriority(). Other methods use the 
+ * interactive class. With ConnectionPool_setPriorityLimits() a class can 
+ * have connections reserved, which other classes cannot take, and a limit
+ * on how many connections it may use, so that for instance batch jobs
+ * cannot exhaust the pool. Waiting threads are served in proportion to the
+ * weight of their class and a class's wait queue can be bounded with 
+ * ConnectionPool_setPriorityQueue() so requests fail fast under overload.
+ * <pre>
+ * // Keep 5 connections for interactive requests and let batch use at most 10
+ * ConnectionPool_setPriorityLimits(pool, Priority_interactive, 5, 0);
+ * ConnectionPool_setPriorityLimits(pool, Priority_batch, 0, 10);
+ * // Shed batch requests if more than 20 are waiting
+ * ConnectionPool_setPriorityQueue(pool, Priority_batch, 2, 20);
+ * ..
+ * Connection_T con = ConnectionPool_getConnectionWithPriority(pool, Priority_batch, 1000);
+ * </pre>
+ *
+ * <h2 class="desc">Leak detection:</h2>
+ * A connection which is checked out and never returned reduces the pool's
+ * capacity. With ConnectionPool_setLeakDetection(), the reaper reports 
+ * connections held longer than a threshold to a callback, with the tag of
+ * the code which checked it out if ConnectionPool_getConnectionWithTag() 
+ * was used. With ConnectionPool_setLeakReclaim() leaked connections are 
+ * also taken out of the pool so the capacity is regained.
+ *
+ * <h2 class="desc">Statement cache:</h2>
+ * With ConnectionPool_setStatementCache() each connection keeps the 
+ * statements prepared on it, keyed by the SQL text, also after it is 
+ * returned to the pool. Connection_prepareStatement() then returns the 
+ * cached statement instead of preparing the same SQL again, which saves a
+ * round trip and the server's parse and plan of the statement.
+ * <pre>
+ * ConnectionPool_setStatementCache(pool, 100, 0);
+ * ..
+ * PreparedStatement_T p = Connection_prepareStatement(con, "select name from employee where id = ?");
+ * </pre>
+ *
+ * <h2 class="desc">Batch rewrite:</h2>
+ * Some servers execute a batch, see PreparedStatement_addBatch(), one
+ * statement at a time. With ConnectionPool_setBatchRewrite() a batch of a
+ * single-row <code>INSERT ... VALUES (?, ..)</code> statement is instead
+ * executed as multi-row <code>INSERT ... VALUES (?, ..), (?, ..), ..</code>
+ * statements, each with as many rows as the server's limits on parameters
+ * and message size allow. This is typically many times faster on MySQL and
+ * PostgreSQL. Oracle uses array DML and is not rewritten.
+ *
+ * <h2 class="desc">Deferred reset:</h2>
+ * When a connection is returned, an open transaction is rolled back and 
+ * prepared statements, result sets and the query timeout are cleared, 
+ * which can take several round trips to the database. With 
+ * ConnectionPool_setDeferredReset() this is done by a background reset 
+ * thread, so Connection_close() returns at once and the connection becomes
+ * available again when it has been reset. Unless the pool sets up sessions
+ * with ConnectionPool_setInitSQL(), ConnectionPool_setConnectionInitializer()
+ * or ConnectionPool_addPreparedStatement(), or cache prepared statements,
+ * the reset thread also resets the session on the server, with 
+ * <code>DISCARD ALL</code> on PostgreSQL and 
+ * <code>mysql_reset_connection()</code> on MySQL, so temporary tables,
+ * session variables and locks are not left for the next user.
+ *
+ * <h2 class="desc">Circuit breaker:</h2>
+ * When the database is down, threads which need a new connection would 
+ * each wait for the connect to time out and together flood the server 
+ * with connects when it recovers. The pool therefore has a circuit breaker.
+ * After a number of consecutive failed connects the circuit opens and no 
+ * connection is opened for a backoff period, which doubles on each trip and
+ * is randomized so pools do not retry at the same time. Meanwhile, 
+ * requests which need a new connection fail at once, while idle 
+ * connections are still handed out. When the period expires, one connect 
+ * is let through as a probe (half-open). If it succeeds, the circuit closes, 
+ * otherwise it opens again. Use ConnectionPool_setCircuitBreaker() to 
+ * change the number of failures and the maximum backoff, or to disable the
+ * circuit breaker.
+ *
+ * <h2 class="desc">Connection initialization:</h2>
+ * Session setup, such as setting the time zone or search path, can be 
+ * done once per connection, when the connection is opened, with 
+ * ConnectionPool_setInitSQL() or with a callback set with
+ * ConnectionPool_setConnectionInitializer(). Statements used on every
+ * connection can be prepared in advance with 
+ * ConnectionPool_addPreparedStatement(). Connection_prepareStatement() 
+ * returns the already prepared statement when called with the same SQL, so 
+ * no request pays for preparing it, also not when the pool grows.
+ * <pre>
+ * ConnectionPool_setInitSQL(pool, "SET TIME ZONE 'UTC'; SET search_path TO app");
+ * ConnectionPool_addPreparedStatement(pool, "select name from employee where id = ?");
+ * ConnectionPool_start(pool);
+ * ..
+ * Connection_T con = ConnectionPool_getConnection(pool);
+ * // Return the statement prepared when con was opened
+ * PreparedStatement_T p = Connection_prepareStatement(con, "select name from employee where id = ?");
+ * </pre>
+ *
+ * <h2 class="desc">Multiple hosts:</h2>
+ * The pool URL may list several hosts, such as 
+ * <code>mysql://db1:3306,db2:3306,db3:3306/test</code>. Each new connection
+ * is opened to the faster of two hosts picked in round-robin order, based on
+ * measured connect and ping latency. If a host cannot be reached, the next
+ * host is tried and the failed host is not used for a backoff period, from
+ * 1 second doubling up to 1 minute. A host which is much slower than the 
+ * fastest host is not used for new connections and the reaper closes its 
+ * idle connections one per sweep, so load moves gradually to the other hosts.
+ *
+ * <h2 class="desc">Concurrency:</h2>
+ * Idle connections are kept in a number of shards, one per CPU (max 16).
+ * Each shard is a LIFO stack with its own lock and a thread will return and
+ * obtain connections from the same shard, stealing from other shards only if
+ * its own shard is empty. As a result, check-out and return are O(1) and 
+ * rarely contend, and a thread will usually get back the connection it 
+ * returned last, while it is still warm. The pool lock is only taken when 
+ * connections are created or closed, or to admit a check-out if priority
+ * classes have reserved connections or limits.
  *
  * <i>This ConnectionPool is thread-safe.</i>
  *
@@ -235,11 +377,132 @@
 #define T ConnectionPool_T
 typedef struct ConnectionPool_S *T;
 
+/**
+ * Connection validation policies. See ConnectionPool_setValidation()
+ */
+typedef enum {
+        Validation_never = 0,
+        Validation_idle,
+        Validation_background
+} Validation_T;
+
+/**
+ * Priority classes for ConnectionPool_getConnectionWithPriority()
+ */
+typedef enum {
+        Priority_interactive = 0,
+        Priority_batch,
+        Priority_background
+} Priority_T;
+
+/**
+ * Number of priority classes
+ */
+#define LIBZDB_PRIORITY_CLASSES 3
+
+/**
+ * Circuit breaker states
+ * @see ConnectionPool_getCircuitState
+ */
+typedef enum {
+        Circuit_closed = 0,     /**< Connections are opened as needed */
+        Circuit_open,           /**< No connection is opened until the backoff expires */
+        Circuit_halfOpen        /**< A probe connect is in progress */
+} Circuit_T;
+
+/**
+ * Number of buckets in a Statistics_T histogram. Bucket <i>i</i> counts
+ * durations less than 2<sup>i</sup> microseconds, the last bucket counts 
+ * all longer durations
+ */
+#define LIBZDB_HISTOGRAM_BUCKETS 32
+
+/**
+ * A snapshot of pool statistics. See ConnectionPool_getStatistics(). 
+ * Counters are totals since the pool was created and durations are in
+ * microseconds.
+ */
+typedef struct Statistics_T {
+        long long checkouts;    /**< Connections handed out */
+        long long timeouts;     /**< Requests for a Connection which returned NULL */
+        long long creations;    /**< Connections opened */
+        long long failures;     /**< Failed attempts to open a Connection */
+        long long reaped;       /**< Connections closed by the reaper or a failed ping */
+        long long leaks;        /**< Connections held longer than the leak threshold */
+        long long shed;         /**< Requests rejected because the wait queue of their priority class was full */
+        long long trips;        /**< Times the circuit breaker opened */
+        long long statementHits;   /**< Prepared statements found in a Connection's statement cache */
+        long long statementMisses; /**< Prepared statements which had to be prepared */
+        long long checkoutLockTime; /**< Time the pool mutex was held to check out and return Connections */
+        int size;               /**< Connections in the pool */
+        int active;             /**< Connections in use */
+        int waiting;            /**< Threads waiting for a Connection */
+        long long waitTimeSum;  /**< Sum of waitTime */
+        long long holdTimeSum;  /**< Sum of holdTime */
+        long long waitTime[LIBZDB_HISTOGRAM_BUCKETS]; /**< Time to obtain a Connection */
+        long long holdTime[LIBZDB_HISTOGRAM_BUCKETS]; /**< Time a Connection was in use */
+} Statistics_T;
+
+/**
+ * A tag with the source file and line of the caller, for use with
+ * ConnectionPool_getConnectionWithTag()
+ */
+#define LIBZDB_CALLER __FILE__ ":" LIBZDB_STR(__LINE__)
+#define LIBZDB_STR(x) LIBZDB_XSTR(x)
+#define LIBZDB_XSTR(x) #x
+
 /**
  * Library Debug flag. If set to true, emit debug output 
  */
 extern int ZBDEBUG;
 
+//<< Protected methods
+
+/**
+ * Select the host a new Connection should be opened to. With a multi-host
+ * URL, of the next two hosts in round-robin order which are neither ejected
+ * nor slow outliers, the one with the lowest latency is selected. If no 
+ * host is usable, the host whose ejection ends first is selected.
+ * @param P A ConnectionPool object
+ * @return The index of the host in the pool URL, 0 for a single host URL
+ * @see URL_getHostAt
+ */
+int ConnectionPool_selectHost(T P) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Report the outcome of a connect or ping to a host. The latency is added
+ * to the host's moving average. A failed connect ejects the host for a 
+ * backoff period which doubles with each consecutive failure.
+ * @param P A ConnectionPool object
+ * @param host The index of the host in the pool URL
+ * @param latency The connect or ping time in microseconds
+ * @param ok false if the connect failed
+ */
+void ConnectionPool_reportHost(T P, int host, long long latency, bool ok) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Initialize a new Connection before it is added to the pool. Execute the
+ * SQL set with ConnectionPool_setInitSQL(), call the initializer set with
+ * ConnectionPool_setConnectionInitializer() and prepare the statements
+ * added with ConnectionPool_addPreparedStatement().
+ * @param P A ConnectionPool object
+ * @param connection A new Connection
+ * @exception SQLException If initialization failed
+ */
+void ConnectionPool_initConnection(T P, Connection_T connection) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Count a statement cache lookup in the pool statistics
+ * @param P A ConnectionPool object
+ * @param hit true if the statement was found in the cache
+ */
+void ConnectionPool_reportStatement(T P, bool hit) __attribute__ ((visibility("hidden")));
+
+//>> End Protected methods
+
 
 /**
  * Create a new ConnectionPool. The pool is created with default 5
@@ -311,6 +574,105 @@ void ConnectionPool_setMaxConnections(T P, int maxConnections);
 int ConnectionPool_getMaxConnections(T P);
 
 
+/**
+ * Set the minimum number of idle Connections the pool should keep ready.
+ * If <code>minIdle</code> is greater than 0, ConnectionPool_start() starts
+ * a builder thread which opens new Connections in the background whenever
+ * the number of idle Connections drops below <code>minIdle</code> or a 
+ * thread is waiting for a Connection, as long as <i>maxConnections</i> is
+ * not reached. Callers then never pay the cost of opening a Connection. If
+ * no idle Connection is available, ConnectionPool_getConnection() returns 
+ * NULL at once while ConnectionPool_getConnectionWithTimeout() waits for
+ * the builder. The reaper thread will not close idle Connections below 
+ * <code>minIdle</code>. Default is 0, no builder thread.
+ * @param P A ConnectionPool object
+ * @param minIdle The minimum number of idle Connections (value >= 0)
+ */
+void ConnectionPool_setMinIdle(T P, int minIdle);
+
+
+/**
+ * Get the minimum number of idle Connections the pool keeps ready
+ * @param P A ConnectionPool object
+ * @return The minimum number of idle Connections
+ * @see ConnectionPool_setMinIdle
+ */
+int ConnectionPool_getMinIdle(T P);
+
+
+/**
+ * Let the pool grow and shrink itself toward a target utilization. At each
+ * sweep of the reaper thread, the number of Connections needed is estimated
+ * from the measured check-out rate and the mean time a Connection is in use
+ * (Little's law), and the pool is sized so this is <code>percent</code> of
+ * the pool. Connections are opened in advance by the reaper thread, and if
+ * callers had to wait for a Connection, the pool grows by at least one.
+ * Surplus idle Connections are closed, at most a quarter of the pool per
+ * sweep. The pool is kept between <i>initialConnections</i> (or 
+ * <i>minIdle</i> if larger) and <i>maxConnections</i>. Requires the reaper
+ * thread, see ConnectionPool_setReaper(). The default is 0, which disables
+ * adaptive sizing.
+ * @param P A ConnectionPool object
+ * @param percent Target utilization in percent (0 <= value <= 100)
+ */
+void ConnectionPool_setTargetUtilization(T P, int percent);
+
+
+/**
+ * Get the target utilization of adaptive pool sizing
+ * @param P A ConnectionPool object
+ * @return The target utilization in percent or 0 if not used
+ * @see ConnectionPool_setTargetUtilization
+ */
+int ConnectionPool_getTargetUtilization(T P);
+
+
+/**
+ * Add a read replica to the pool. Connections to the replica are kept in
+ * a separate pool which is started, stopped and freed together with this 
+ * pool and uses the same properties, such as initial and maximum 
+ * connections. Replicas should be added <em>before</em> calling 
+ * ConnectionPool_start(). The reaper thread measures the latency and 
+ * replication lag of each replica at each sweep and a replica which fails 
+ * is not used until it responds again. A pool with replicas therefore 
+ * always runs the reaper thread; if ConnectionPool_setReaper() was not 
+ * called, it only checks the replicas, every SQL_DEFAULT_SWEEP_INTERVAL 
+ * seconds. The caller retains ownership of <code>url</code> which
+ * must remain valid until the pool is freed.
+ * @param P A ConnectionPool object
+ * @param url The URL of the replica database
+ * @see ConnectionPool_getReadConnection
+ */
+void ConnectionPool_addReplica(T P, URL_T url);
+
+
+/**
+ * Returns the number of read replicas added to the pool
+ * @param P A ConnectionPool object
+ * @return The number of replicas
+ */
+int ConnectionPool_replicas(T P);
+
+
+/**
+ * Set the maximum replication lag in milliseconds a replica may have and
+ * still be used by ConnectionPool_getReadConnection(). The lag is measured
+ * by the reaper thread. Default is 10000 milliseconds.
+ * @param P A ConnectionPool object
+ * @param ms Maximum replication lag in milliseconds (value >= 0)
+ */
+void ConnectionPool_setMaxReplicationLag(T P, int ms);
+
+
+/**
+ * Returns the maximum replication lag in milliseconds
+ * @param P A ConnectionPool object
+ * @return The maximum replication lag a replica may have
+ * @see ConnectionPool_setMaxReplicationLag
+ */
+int ConnectionPool_getMaxReplicationLag(T P);
+
+
 /**
  * Set a Connection inactive timeout value in seconds. The method,
  * ConnectionPool_reapConnections(), if called, will close inactive
@@ -353,6 +715,93 @@ int ConnectionPool_getConnectionTimeout(T P);
 void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error));
 
 
+/**
+ * Set a function to call once for each new Connection, before it is added
+ * to the pool and handed out. Use it for session setup which cannot be 
+ * expressed as SQL. If the function throws an SQLException the Connection 
+ * is closed and counted as a failed attempt to open a Connection. The 
+ * function is called from the thread which opens the Connection, which can
+ * be the builder or reaper thread, and may be called concurrently for 
+ * initial connections which are opened in parallel at start.
+ * @param P A ConnectionPool object
+ * @param initializer The function to call with the new Connection or NULL
+ * to remove a previously set function
+ * @see ConnectionPool_setInitSQL
+ */
+void ConnectionPool_setConnectionInitializer(T P, void(*initializer)(Connection_T connection));
+
+
+/**
+ * Set SQL to execute once for each new Connection, before the initializer
+ * function, if any, is called. The SQL may contain several statements
+ * separated by semicolon, for instance to set the time zone and search
+ * path of the session.
+ * @param P A ConnectionPool object
+ * @param sql The SQL to execute or NULL to remove previously set SQL. The
+ * string is copied
+ * @see ConnectionPool_setConnectionInitializer
+ */
+void ConnectionPool_setInitSQL(T P, const char *sql);
+
+
+/**
+ * Returns the SQL executed for each new Connection
+ * @param P A ConnectionPool object
+ * @return The SQL or NULL if not set
+ * @see ConnectionPool_setInitSQL
+ */
+const char *ConnectionPool_getInitSQL(T P);
+
+
+/**
+ * Add a SQL statement to prepare on each new Connection, before it is
+ * handed out. Connection_prepareStatement() called with the exact same 
+ * <code>sql</code> returns the prepared statement instead of preparing it 
+ * again. Such a statement is kept as long as the Connection is open, also
+ * when the Connection is returned to the pool. Statements should be added
+ * <em>before</em> calling ConnectionPool_start().
+ * @param P A ConnectionPool object
+ * @param sql A SQL statement. The string is copied
+ * @see Connection_prepareStatement
+ */
+void ConnectionPool_addPreparedStatement(T P, const char *sql);
+
+
+/**
+ * Set how the pool validates that a Connection is alive before it is
+ * handed out. Validating a Connection means calling Connection_ping(), 
+ * which for some database systems, such as MySQL, is a round trip to the
+ * database server. The following policies are available:
+ * <ul>
+ * <li><code>Validation_idle</code> - ping the Connection at check-out if it
+ * has been idle in the pool for longer than <code>idleTime</code>
+ * milliseconds. This is the default with an <code>idleTime</code> of 0,
+ * i.e. every Connection is pinged at check-out.</li>
+ * <li><code>Validation_background</code> - never ping at check-out. Instead
+ * the reaper thread pings idle Connections at each sweep, outside the 
+ * check-out path, and close those that do not respond. Use together with
+ * ConnectionPool_setReaper().</li>
+ * <li><code>Validation_never</code> - never ping at check-out. Only the
+ * reaper pings Connections it is about to keep or close.</li>
+ * </ul>
+ * @param P A ConnectionPool object
+ * @param policy The validation policy
+ * @param idleTime Number of milliseconds a Connection can be idle before it
+ * is pinged at check-out. Only used with <code>Validation_idle</code>.
+ * (value >= 0)
+ */
+void ConnectionPool_setValidation(T P, Validation_T policy, int idleTime);
+
+
+/**
+ * Returns the validation policy used by the pool
+ * @param P A ConnectionPool object
+ * @return The validation policy
+ * @see ConnectionPool_setValidation
+ */
+Validation_T ConnectionPool_getValidation(T P);
+
+
 /**
  * Specify that a reaper thread should be used by the pool. This thread 
  * will close all inactive Connections in the pool, down to initial 
@@ -372,6 +821,187 @@ void ConnectionPool_setAbortHandler(T P, void(*abortHandler)(const char *error))
 void ConnectionPool_setReaper(T P, int sweepInterval);
 
 
+/**
+ * Set the connections reserved for a priority class and the maximum
+ * number of connections the class may use at the same time. Reserved 
+ * connections which are not in use by the class cannot be taken by other 
+ * classes. By default no connections are reserved and there is no limit.
+ * @param P A ConnectionPool object
+ * @param priority The priority class
+ * @param reserved Number of connections reserved for the class 
+ * (value >= 0). The sum of reservations should be less than 
+ * <i>maxConnections</i>
+ * @param limit Maximum number of active connections in the class or 0 for
+ * no limit (value >= 0)
+ * @see ConnectionPool_getConnectionWithPriority
+ */
+void ConnectionPool_setPriorityLimits(T P, Priority_T priority, int reserved, int limit);
+
+
+/**
+ * Set the weight and wait queue bound of a priority class. When 
+ * connections are handed to waiting threads, each class is served in
+ * proportion to its weight. The default weights are 4 for interactive, 2
+ * for batch and 1 for background. A request is rejected at once, and 
+ * counted as shed in the pool statistics, if <code>maxWaiting</code> 
+ * threads of its class are already waiting.
+ * @param P A ConnectionPool object
+ * @param priority The priority class
+ * @param weight The weight of the class (value > 0)
+ * @param maxWaiting Maximum number of waiting threads in the class or 0 
+ * for no bound (value >= 0)
+ * @see ConnectionPool_getConnectionWithPriority
+ */
+void ConnectionPool_setPriorityQueue(T P, Priority_T priority, int weight, int maxWaiting);
+
+
+/**
+ * Enable a prepared statement cache in each connection. 
+ * Connection_prepareStatement() returns a statement prepared earlier on the
+ * same connection with the same SQL text, also by a previous user of the
+ * connection, instead of preparing it again. When the cache is full, the 
+ * least recently used statement is closed. Statements prepared before a 
+ * reconnect are not taken from the cache. Hits and misses are counted in 
+ * the pool statistics. By default the cache is disabled.
+ * @param P A ConnectionPool object
+ * @param size Maximum number of cached statements per connection or 0 to
+ * disable the cache (value >= 0)
+ * @param memory Maximum size in bytes of the SQL text of the cached
+ * statements per connection or 0 for no limit (value >= 0). Default is 
+ * SQL_DEFAULT_STATEMENT_CACHE_MEMORY
+ * @see Connection_prepareStatement
+ */
+void ConnectionPool_setStatementCache(T P, int size, int memory);
+
+
+/**
+ * Returns the maximum number of cached statements per connection
+ * @param P A ConnectionPool object
+ * @return The statement cache size or 0 if disabled
+ * @see ConnectionPool_setStatementCache
+ */
+int ConnectionPool_getStatementCacheSize(T P);
+
+
+/**
+ * Returns the maximum SQL text size in bytes of cached statements per 
+ * connection
+ * @param P A ConnectionPool object
+ * @return The statement cache memory limit or 0 if unlimited
+ * @see ConnectionPool_setStatementCache
+ */
+int ConnectionPool_getStatementCacheMemory(T P);
+
+
+/**
+ * Execute batches of single-row INSERT statements as multi-row INSERT
+ * statements. Applies to statements prepared after this method is called.
+ * Rows changed are reported for each batch entry if each row inserted one
+ * row, otherwise -1. Default is false.
+ * @param P A ConnectionPool object
+ * @param rewrite true to rewrite batched INSERT statements
+ * @see PreparedStatement_executeBatch
+ */
+void ConnectionPool_setBatchRewrite(T P, bool rewrite);
+
+
+/**
+ * Returns true if batched INSERT statements are rewritten to multi-row
+ * INSERT statements
+ * @param P A ConnectionPool object
+ * @return true if batch rewrite is enabled
+ * @see ConnectionPool_setBatchRewrite
+ */
+bool ConnectionPool_getBatchRewrite(T P);
+
+
+/**
+ * Reset returned connections on a background thread instead of in 
+ * Connection_close(). A connection which does not need to be reset is 
+ * still returned directly. The reset thread is started by 
+ * ConnectionPool_start() so this method must be called before the pool 
+ * is started. Default is false.
+ * @param P A ConnectionPool object
+ * @param deferred true to reset returned connections in the background
+ */
+void ConnectionPool_setDeferredReset(T P, bool deferred);
+
+
+/**
+ * Returns true if returned connections are reset in the background
+ * @param P A ConnectionPool object
+ * @return true if deferred reset is enabled
+ * @see ConnectionPool_setDeferredReset
+ */
+bool ConnectionPool_getDeferredReset(T P);
+
+
+/**
+ * Configure the circuit breaker on opening connections. The circuit opens
+ * after <code>failures</code> consecutive failed connects and stays open 
+ * from SQL_BREAKER_BACKOFF milliseconds, doubling on each consecutive 
+ * trip, up to <code>maxBackoff</code> milliseconds. The default is 
+ * SQL_BREAKER_FAILURES failures and SQL_BREAKER_MAX_BACKOFF milliseconds.
+ * @param P A ConnectionPool object
+ * @param failures Number of consecutive failed connects which open the 
+ * circuit or 0 to disable the circuit breaker (value >= 0)
+ * @param maxBackoff Maximum milliseconds the circuit stays open (value > 0)
+ * @see ConnectionPool_getCircuitState
+ */
+void ConnectionPool_setCircuitBreaker(T P, int failures, int maxBackoff);
+
+
+/**
+ * Returns the state of the circuit breaker
+ * @param P A ConnectionPool object
+ * @return Circuit_closed, Circuit_open or Circuit_halfOpen
+ * @see ConnectionPool_setCircuitBreaker
+ */
+Circuit_T ConnectionPool_getCircuitState(T P);
+
+
+/**
+ * Enable connection leak detection. At each sweep, the reaper thread 
+ * reports connections which have been checked out for longer than 
+ * <code>threshold</code> milliseconds to <code>leakHandler</code>, once
+ * per check-out. The handler is given the tag set with 
+ * ConnectionPool_getConnectionWithTag(), or NULL, and the number of 
+ * milliseconds the connection has been held. Requires the reaper thread,
+ * see ConnectionPool_setReaper().
+ * @param P A ConnectionPool object
+ * @param threshold Number of milliseconds a connection can be checked out
+ * before it is considered leaked. 0 disables leak detection (value >= 0)
+ * @param leakHandler The function to call for each leaked connection or
+ * NULL to only count leaks in the pool statistics
+ * @see ConnectionPool_setLeakReclaim
+ */
+void ConnectionPool_setLeakDetection(T P, int threshold, void(*leakHandler)(const char *tag, long long heldTime));
+
+
+/**
+ * Returns the number of milliseconds a connection can be checked out before
+ * it is considered leaked
+ * @param P A ConnectionPool object
+ * @return The leak threshold or 0 if leak detection is disabled
+ * @see ConnectionPool_setLeakDetection
+ */
+int ConnectionPool_getLeakThreshold(T P);
+
+
+/**
+ * Specify if leaked connections should be reclaimed. A reclaimed connection
+ * is taken out of the pool and no longer counts against 
+ * <i>maxConnections</i>, so a leak does not reduce the pool's capacity. The
+ * database connection is not closed while the holder may still use it, 
+ * but when the holder eventually returns it with Connection_close(). Default
+ * is false.
+ * @param P A ConnectionPool object
+ * @param reclaim true to reclaim leaked connections
+ * @see ConnectionPool_setLeakDetection
+ */
+void ConnectionPool_setLeakReclaim(T P, bool reclaim);
+
+
 /**
  * Returns the current number of connections in the pool. The number of 
  * both active and inactive connections are returned.
@@ -389,15 +1019,51 @@ int ConnectionPool_size(T P);
  */
 int ConnectionPool_active(T P);
 
+
+/**
+ * Returns a snapshot of the pool statistics. Statistics are recorded in 
+ * per-shard counters by the thread doing the work and are summed here 
+ * without locking the pool, so the snapshot is cheap but the counters may
+ * not be mutually consistent while the pool is in use.
+ * @param P A ConnectionPool object
+ * @return A snapshot of the pool statistics
+ */
+Statistics_T ConnectionPool_getStatistics(T P);
+
+
+/**
+ * Write a statistics snapshot in the Prometheus text exposition format. 
+ * Metrics are named <code>libzdb_pool_*</code> and are labeled with 
+ * <code>name</code>. Histograms are written with bucket bounds in seconds.
+ * The output is truncated if it does not fit in <code>buf</code> and is 
+ * always NUL terminated if <code>size</code> > 0. 
+ * Example:
+ * <pre>
+ * Statistics_T s = ConnectionPool_getStatistics(pool);
+ * char buf[8192];
+ * ConnectionPool_formatStatistics(&s, "main", buf, sizeof(buf));
+ * </pre>
+ * @param stats A statistics snapshot
+ * @param name Value of the <code>pool</code> label
+ * @param buf The buffer to write to
+ * @param size Size of buf
+ * @return The number of characters the complete output requires, excluding
+ * the terminating NUL, as snprintf(3). If the return value is >= 
+ * <code>size</code> the output was truncated
+ */
+int ConnectionPool_formatStatistics(Statistics_T *stats, const char *name, char *buf, int size);
+
 //@}
 
 /**
  * Prepare for the beginning of active use of this component. This method
  * must be called before the pool is used and will connect to the database
- * server and create the initial connections for the pool. This method will
+ * server and create the initial connections for the pool. Up to 
+ * SQL_MAX_CONNECT_THREADS connections are opened in parallel. The pool is
+ * started if at least one connection could be opened. This method will
  * also start the reaper thread if specified via ConnectionPool_setReaper().
  * @param P A ConnectionPool object
- * @exception SQLException If a database error occurs.
+ * @exception SQLException If no connection could be opened.
  * @see SQLException.h
  */
 void ConnectionPool_start(T P);
@@ -407,8 +1073,9 @@ void ConnectionPool_start(T P);
  * Gracefully terminate the active use of the public methods of this
  * component. This method should be the last one called on a given instance
  * of this component. Calling this method close down all connections in the 
- * pool, disconnect the pool from the database server and stop the reaper
- * thread if it was started.
+ * pool, in parallel as the connections are opened at start, disconnect 
+ * the pool from the database server and stop the reaper thread if it was
+ * started.
  * @param P A ConnectionPool object
  */
 void ConnectionPool_stop(T P);
@@ -417,12 +1084,83 @@ void ConnectionPool_stop(T P);
 /**
  * Get a connection from the pool
  * @param P A ConnectionPool object
- * @return A connection from the pool or NULL if maxConnection is reached
+ * @return A connection from the pool or NULL if maxConnection is reached,
+ * a new connection is needed while the circuit breaker is open or, with a
+ * builder thread, no connection is idle. This method does not wait, use 
+ * ConnectionPool_getConnectionWithTimeout() to wait for a connection
  * @see Connection.h
+ * @see ConnectionPool_setMinIdle
  */
 Connection_T ConnectionPool_getConnection(T P);
 
 
+/**
+ * Get a connection from the pool and wait up to <code>ms</code> milliseconds
+ * for one to become available if <i>maxConnections</i> is reached. Waiting
+ * threads are queued in FIFO order and a connection returned to the pool
+ * is handed directly to the thread that has waited the longest. Use this 
+ * method instead of retrying ConnectionPool_getConnection() in a loop.
+ * @param P A ConnectionPool object
+ * @param ms Maximum number of milliseconds to wait. If 0, this method
+ * behaves as ConnectionPool_getConnection(). (value >= 0)
+ * @return A connection from the pool or NULL if no connection became
+ * available within <code>ms</code> milliseconds or the pool was stopped
+ * @see Connection.h
+ */
+Connection_T ConnectionPool_getConnectionWithTimeout(T P, int ms);
+
+
+/**
+ * Get a connection for a priority class, waiting up to <code>ms</code> 
+ * milliseconds as ConnectionPool_getConnectionWithTimeout(). The 
+ * connection is only handed out if the class's limit is not reached and 
+ * it does not take a connection reserved for another class. 
+ * @param P A ConnectionPool object
+ * @param priority The priority class of the caller
+ * @param ms Maximum number of milliseconds to wait (value >= 0)
+ * @return A connection from the pool or NULL if no connection became 
+ * available within <code>ms</code> milliseconds or the wait queue of
+ * the class is full
+ * @see ConnectionPool_setPriorityLimits
+ * @see ConnectionPool_setPriorityQueue
+ */
+Connection_T ConnectionPool_getConnectionWithPriority(T P, Priority_T priority, int ms);
+
+
+/**
+ * Get a connection from the pool as ConnectionPool_getConnection() and tag
+ * it with the caller so a leaked connection can be traced to the code 
+ * which checked it out. Use LIBZDB_CALLER to tag with source file and line:
+ * <pre>
+ * Connection_T con = ConnectionPool_getConnectionWithTag(pool, LIBZDB_CALLER);
+ * </pre>
+ * @param P A ConnectionPool object
+ * @param tag A string identifying the caller. The string is not copied
+ * and must remain valid, such as a string literal
+ * @return A connection from the pool or NULL as 
+ * ConnectionPool_getConnection()
+ * @see ConnectionPool_setLeakDetection
+ */
+Connection_T ConnectionPool_getConnectionWithTag(T P, const char *tag);
+
+
+/**
+ * Get a connection for read-only work. Of the replicas not known to be 
+ * down or lagging, two are considered in round-robin order and a 
+ * connection to the one with the lowest latency is returned. If 
+ * <code>position</code> is not NULL, the replica must also have replayed
+ * changes up to this replication position. Otherwise, or if the pool has
+ * no replicas, a connection to the primary is returned as from 
+ * ConnectionPool_getConnection().
+ * @param P A ConnectionPool object
+ * @param position A replication position from 
+ * Connection_getReplicationPosition() or NULL
+ * @return A connection or NULL if maxConnection is reached
+ * @see ConnectionPool_addReplica
+ */
+Connection_T ConnectionPool_getReadConnection(T P, const char *position);
+
+
 /**
  * Returns a connection to the pool. The same as calling Connection_close()
  * @param P A ConnectionPool object
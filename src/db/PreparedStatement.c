@@ -26,9 +26,16 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
 
+#include "URL.h"
+#include "StringBuffer.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
+#include "BulkLoader.h"
+#include "Connection.h"
 
 
 /**
@@ -41,10 +48,28 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+/*
+ * A single-row INSERT split at its VALUES tuple, so a batch can be executed
+ * as multi-row INSERT statements. The statements are kept for reuse, one
+ * with the full number of rows per statement and one for the remainder
+ */
+typedef struct rewrite_t {
+        char *prefix; // The statement up to the VALUES tuple
+        char *tuple;  // The VALUES tuple, e.g. "(?, ?)"
+        int rows[2];
+        PreparedStatement_T statements[2];
+        Connection_T connection;
+} *rewrite_t;
 #define T PreparedStatement_T
 struct PreparedStatement_S {
         Pop_T op;
+        rewrite_t rewrite;
+        int capacity;
+        int executed;
+        long long *rowsChanged;
         ResultSet_T resultSet;
+        BatchValue_T parameters;
+        struct Batch_T batch;
         PreparedStatementDelegate_T D;
 };
 
@@ -58,6 +83,193 @@ static void _clearResultSet(T P) {
 }
 
 
+static inline BatchValue_T _parameter(T P, int parameterIndex) {
+        if (P->parameters && parameterIndex > 0 && parameterIndex <= P->batch.columns)
+                return &P->parameters[parameterIndex - 1];
+        return NULL;
+}
+
+
+static void _clearBatch(T P) {
+        for (int i = 0; i < P->batch.rows * P->batch.columns; i++) {
+                BatchValue_T v = &P->batch.values[i];
+                if (v->type == Batch_string || v->type == Batch_blob)
+                        FREE(v->v.p);
+        }
+        P->batch.rows = 0;
+}
+
+
+static void _bind(T P, int parameterIndex, BatchValue_T v) {
+        switch (v->type) {
+                case Batch_string:
+                        P->op->setString(P->D, parameterIndex, v->v.p);
+                        break;
+                case Batch_int:
+                        P->op->setInt64(P->D, parameterIndex, v->v.i);
+                        break;
+                case Batch_uint:
+                        P->op->setUInt64(P->D, parameterIndex, v->v.u);
+                        break;
+                case Batch_double:
+                        P->op->setDouble(P->D, parameterIndex, v->v.d);
+                        break;
+                case Batch_timestamp:
+                        P->op->setTimestamp(P->D, parameterIndex, v->v.t);
+                        break;
+                case Batch_blob:
+                        P->op->setBlob(P->D, parameterIndex, v->v.p, v->size);
+                        break;
+                default:
+                        P->op->setString(P->D, parameterIndex, NULL);
+                        break;
+        }
+}
+
+
+static void _executeBatch(T P, Batch_T batch) {
+        if (P->op->executeBatch) {
+                P->op->executeBatch(P->D, batch);
+        } else {
+                for (int row = 0; row < batch->rows; row++) {
+                        for (int i = 0; i < batch->columns; i++)
+                                _bind(P, i + 1, batchValue(batch, row, i));
+                        P->op->execute(P->D);
+                        batch->rowsChanged[row] = P->op->rowsChanged(P->D);
+                }
+        }
+}
+
+
+/* True if the '(' at sql[i] follows the keyword VALUES */
+static bool _isValues(const char *sql, int i) {
+        while (i > 0 && isspace((unsigned char)sql[i - 1]))
+                i--;
+        return (i > 6 && strncasecmp(sql + i - 6, "values", 6) == 0 && ! (isalnum((unsigned char)sql[i - 7]) || sql[i - 7] == '_'));
+}
+
+
+/* If sql is a single-row INSERT with all parameters in its VALUES tuple,
+ returns the offset of the tuple and sets end to the offset after it, 
+ otherwise -1. Statements with comments or backslash escapes are not parsed */
+static int _valuesTuple(const char *sql, int parameters, int *end) {
+        int i = 0, start = -1, depth = 0, count = 0;
+        char quote = 0;
+        while (isspace((unsigned char)sql[i]))
+                i++;
+        if (strncasecmp(sql + i, "insert", 6) != 0 || ! isspace((unsigned char)sql[i + 6]))
+                return -1;
+        for (*end = -1; sql[i]; i++) {
+                char c = sql[i];
+                if (c == '\\')
+                        return -1;
+                if (*end >= 0) {
+                        // Nothing but a terminating semicolon may follow the tuple
+                        if (! (isspace((unsigned char)c) || c == ';'))
+                                return -1;
+                } else if (quote) {
+                        if (c == quote)
+                                quote = 0;
+                } else if (c == '\'' || c == '"' || c == '`') {
+                        quote = c;
+                } else if ((c == '-' && sql[i + 1] == '-') || (c == '/' && sql[i + 1] == '*') || c == ';') {
+                        return -1;
+                } else if (c == '?') {
+                        if (start < 0)
+                                return -1;
+                        count++;
+                } else if (c == '(') {
+                        if (depth++ == 0 && start < 0 && _isValues(sql, i))
+                                start = i;
+                } else if (c == ')') {
+                        if (--depth == 0 && start >= 0)
+                                *end = i + 1;
+                }
+        }
+        return (start >= 0 && *end >= 0 && count == parameters) ? start : -1;
+}
+
+
+/* Returns a statement with rows VALUES tuples, kept in slot */
+static PreparedStatement_T _rewritten(T P, int slot, int rows) {
+        rewrite_t r = P->rewrite;
+        if (r->statements[slot] && r->rows[slot] != rows)
+                PreparedStatement_free(&r->statements[slot]);
+        if (! r->statements[slot]) {
+                StringBuffer_T sb = StringBuffer_create((int)(strlen(r->prefix) + rows * (strlen(r->tuple) + 2) + 1));
+                StringBuffer_append(sb, "%s", r->prefix);
+                for (int i = 0; i < rows; i++)
+                        StringBuffer_append(sb, i ? ", %s" : "%s", r->tuple);
+                r->statements[slot] = Connection_prepareBatchStatement(r->connection, StringBuffer_toString(sb));
+                StringBuffer_free(&sb);
+                if (! r->statements[slot])
+                        THROW(SQLException, "%s", Connection_getLastError(r->connection));
+                r->rows[slot] = rows;
+        }
+        return r->statements[slot];
+}
+
+
+static void _executeRewritten(T P, PreparedStatement_T p, int row, int rows) {
+        int parameterIndex = 1;
+        for (int r = row; r < row + rows; r++)
+                for (int i = 0; i < P->batch.columns; i++)
+                        _bind(p, parameterIndex++, batchValue(&P->batch, r, i));
+        p->op->execute(p->D);
+        // Each row of a plain INSERT inserts at most one row
+        long long changed = p->op->rowsChanged(p->D);
+        for (int r = row; r < row + rows; r++)
+                P->batch.rowsChanged[r] = changed == rows ? 1 : changed == 0 ? 0 : -1;
+}
+
+
+/* Execute the batch as multi-row INSERT statements with as many rows as the
+ database's limits on parameters and message size allow. Returns the number
+ of entries executed */
+static int _rewriteBatch(T P) {
+        long maxPacket;
+        int chunk = Connection_getBatchLimits(P->rewrite->connection, &maxPacket) / P->batch.columns;
+        if (maxPacket > 0) {
+                // Estimate the size of a row's values from the largest row, the statement text is sent in a message of its own
+                long rowSize = 0;
+                for (int row = 0; row < P->batch.rows; row++) {
+                        long size = 0;
+                        for (int i = 0; i < P->batch.columns; i++)
+                                size += batchValue(&P->batch, row, i)->size + 16;
+                        if (size > rowSize)
+                                rowSize = size;
+                }
+                long room = maxPacket - strlen(P->rewrite->prefix) - STRLEN;
+                long tupleSize = strlen(P->rewrite->tuple) + 2;
+                if (room / rowSize < chunk)
+                        chunk = (int)(room / rowSize);
+                if (room / tupleSize < chunk)
+                        chunk = (int)(room / tupleSize);
+        }
+        if (chunk < 2)
+                return 0;
+        int row = 0;
+        for (; P->batch.rows - row >= chunk; row += chunk)
+                _executeRewritten(P, _rewritten(P, 0, chunk), row, chunk);
+        int rest = P->batch.rows - row;
+        if (rest > 1) {
+                _executeRewritten(P, _rewritten(P, 1, rest), row, rest);
+                row += rest;
+        }
+        return row;
+}
+
+
+/* The delegate may refer to values in the batch, so bind all parameters
+ to NULL before the batch values are freed */
+static void _clearParameters(T P) {
+        for (int i = 0; i < P->batch.columns; i++) {
+                P->parameters[i] = (struct BatchValue_T){.type = Batch_null};
+                _bind(P, i + 1, &P->parameters[i]);
+        }
+}
+
+
 /* ----------------------------------------------------- Protected methods */
 
 
@@ -68,6 +280,9 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op) {
         NEW(P);
 	P->D = D;
 	P->op = op;
+        P->batch.columns = op->parameterCount(D);
+        if (P->batch.columns > 0)
+                P->parameters = CALLOC(P->batch.columns, sizeof(struct BatchValue_T));
 	return P;
 }
 
@@ -75,83 +290,168 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op) {
 void PreparedStatement_free(T *P) {
 	assert(P && *P);
         _clearResultSet((*P));
+        _clearBatch((*P));
+        if ((*P)->rewrite) {
+                for (int i = 0; i < 2; i++)
+                        if ((*P)->rewrite->statements[i])
+                                PreparedStatement_free(&(*P)->rewrite->statements[i]);
+                FREE((*P)->rewrite->prefix);
+                FREE((*P)->rewrite->tuple);
+                FREE((*P)->rewrite);
+        }
         (*P)->op->free(&((*P)->D));
+        FREE((*P)->batch.values);
+        FREE((*P)->rowsChanged);
+        FREE((*P)->parameters);
 	FREE(*P);
 }
 
 
+void PreparedStatement_clear(T P) {
+        assert(P);
+        _clearResultSet(P);
+        _clearBatch(P);
+        // Unbind the previous borrower's values so they are not sent again or referred after being freed
+        _clearParameters(P);
+}
+
+
+void PreparedStatement_discard(T P) {
+        assert(P);
+        if (P->op->discard)
+                P->op->discard(P->D);
+        if (P->rewrite)
+                for (int i = 0; i < 2; i++)
+                        if (P->rewrite->statements[i])
+                                PreparedStatement_discard(P->rewrite->statements[i]);
+}
+
+
+void PreparedStatement_setBatchRewrite(T P, Connection_T C, const char *sql) {
+        assert(P);
+        assert(C);
+        assert(sql);
+        int end;
+        if (P->rewrite || P->batch.columns == 0)
+                return;
+        int start = _valuesTuple(sql, P->batch.columns, &end);
+        if (start >= 0) {
+                NEW(P->rewrite);
+                P->rewrite->connection = C;
+                P->rewrite->prefix = Str_ndup(sql, start);
+                P->rewrite->tuple = Str_ndup(sql + start, end - start);
+        }
+}
+
+
 /* ------------------------------------------------------------ Parameters */
 
 
 void PreparedStatement_setString(T P, int parameterIndex, const char *x) {
 	assert(P);
         P->op->setString(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = x ? Batch_string : Batch_null, .v.p = (void *)x};
 }
 
 
 void PreparedStatement_setInt8(T P, int parameterIndex, int8_t x) {
     assert(P);
         P->op->setInt8(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setUInt8(T P, int parameterIndex, uint8_t x) {
     assert(P);
         P->op->setUInt8(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setInt16(T P, int parameterIndex, int16_t x) {
     assert(P);
         P->op->setInt16(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setUInt16(T P, int parameterIndex, uint16_t x) {
     assert(P);
         P->op->setUInt16(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setInt32(T P, int parameterIndex, int32_t x) {
     assert(P);
         P->op->setInt32(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setUInt32(T P, int parameterIndex, uint32_t x) {
     assert(P);
         P->op->setUInt32(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setInt64(T P, int parameterIndex, int64_t x) {
     assert(P);
         P->op->setInt64(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_int, .v.i = x};
 }
 
 
 void PreparedStatement_setUInt64(T P, int parameterIndex, uint64_t x) {
     assert(P);
         P->op->setUInt64(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_uint, .v.u = x};
 }
 
 
 void PreparedStatement_setDouble(T P, int parameterIndex, double x) {
 	assert(P);
         P->op->setDouble(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_double, .v.d = x};
 }
 
 
 void PreparedStatement_setBlob(T P, int parameterIndex, const void *x, int size) {
 	assert(P);
         P->op->setBlob(P->D, parameterIndex, x, size);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = x ? Batch_blob : Batch_null, .size = x ? size : 0, .v.p = (void *)x};
 }
 
 
 void PreparedStatement_setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         P->op->setTimestamp(P->D, parameterIndex, x);
+        BatchValue_T v = _parameter(P, parameterIndex);
+        if (v)
+                *v = (struct BatchValue_T){.type = Batch_timestamp, .v.t = x};
 }
 
 
@@ -181,6 +481,82 @@ long long PreparedStatement_rowsChanged(T P) {
 }
 
 
+/* ----------------------------------------------------------------- Batch */
+
+
+void PreparedStatement_addBatch(T P) {
+        assert(P);
+        if (P->batch.rows == P->capacity) {
+                P->capacity = P->capacity ? P->capacity * 2 : 16;
+                if (P->batch.columns > 0) {
+                        long size = (long)P->capacity * P->batch.columns * sizeof(struct BatchValue_T);
+                        if (P->batch.values)
+                                RESIZE(P->batch.values, size);
+                        else
+                                P->batch.values = ALLOC(size);
+                }
+        }
+        for (int i = 0; i < P->batch.columns; i++) {
+                BatchValue_T v = batchValue(&P->batch, P->batch.rows, i);
+                *v = P->parameters[i];
+                if (v->type == Batch_string) {
+                        v->size = (int)strlen(v->v.p);
+                        v->v.p = Str_ndup(v->v.p, v->size);
+                } else if (v->type == Batch_blob) {
+                        void *copy = ALLOC(v->size + 1);
+                        memcpy(copy, v->v.p, v->size);
+                        v->v.p = copy;
+                }
+        }
+        P->batch.rows++;
+}
+
+
+int PreparedStatement_executeBatch(T P) {
+        assert(P);
+        _clearResultSet(P);
+        int rows = P->executed = P->batch.rows;
+        if (rows > 0) {
+                FREE(P->rowsChanged);
+                P->rowsChanged = P->batch.rowsChanged = CALLOC(rows, sizeof(long long));
+                TRY
+                {
+                        int done = P->rewrite && rows > 1 ? _rewriteBatch(P) : 0;
+                        if (done < rows) {
+                                struct Batch_T rest = {
+                                        .rows = rows - done,
+                                        .columns = P->batch.columns,
+                                        .values = P->batch.columns ? batchValue(&P->batch, done, 0) : NULL,
+                                        .rowsChanged = P->batch.rowsChanged + done
+                                };
+                                _executeBatch(P, &rest);
+                        }
+                }
+                FINALLY
+                {
+                        _clearParameters(P);
+                        _clearBatch(P);
+                }
+                END_TRY;
+        }
+        return rows;
+}
+
+
+long long PreparedStatement_getBatchRowsChanged(T P, int index) {
+        assert(P);
+        if (index < 1 || index > P->executed)
+                THROW(SQLException, "Batch index is out of range");
+        return P->rowsChanged[index - 1];
+}
+
+
+void PreparedStatement_clearBatch(T P) {
+        assert(P);
+        _clearBatch(P);
+}
+
+
 /* ------------------------------------------------------------ Properties */
 
 
@@ -188,3 +564,9 @@ int PreparedStatement_getParameterCount(T P) {
         assert(P);
         return P->op->parameterCount(P->D);
 }
+
+
+int PreparedStatement_getBatchSize(T P) {
+        assert(P);
+        return P->batch.rows;
+}
@@ -29,6 +29,7 @@
 //<< Protected methods
 #include "PreparedStatementDelegate.h"
 #include <stdint.h>
+struct Connection_S;
 //>> End Protected methods
 
 
@@ -95,6 +96,28 @@
  * the Prepared Statement is executed again or until the Connection is
  * returned to the Connection Pool. 
  *
+ * <h2 class="desc">Batch:</h2>
+ * Instead of executing the statement once for each set of parameters,
+ * PreparedStatement_addBatch() adds the current parameter values to a batch
+ * and PreparedStatement_executeBatch() executes all of them at once. String
+ * and blob values are copied when added, so the caller's buffers can be
+ * reused for the next entry. Batches are sent to the database without
+ * a round-trip for each entry where the database supports it; PostgreSQL
+ * in pipeline mode (libpq 14 or later), MariaDB with array binding, Oracle
+ * with array DML and SQLite in one transaction if in auto-commit mode.
+ * <pre>
+ * PreparedStatement_T p = Connection_prepareStatement(con, "INSERT INTO employee(name, salary) VALUES(?, ?)");
+ * for (int i = 0; employees[i]; i++)
+ * {
+ *        PreparedStatement_setString(p, 1, employees[i].name);
+ *        PreparedStatement_setDouble(p, 2, employees[i].salary);
+ *        PreparedStatement_addBatch(p);
+ * }
+ * int n = PreparedStatement_executeBatch(p);
+ * for (int i = 1; i <= n; i++)
+ *        printf("%lld\n", PreparedStatement_getBatchRowsChanged(p, i));
+ * </pre>
+ *
  * <h2 class="desc">Date and Time</h2>
  * PreparedStatement provides PreparedStatement_setTimestamp() for setting a
  * Unix timestamp value. To set SQL Date, Time or DateTime values, simply use
@@ -131,6 +154,34 @@ T PreparedStatement_new(PreparedStatementDelegate_T D, Pop_T op) __attribute__ (
  */
 void PreparedStatement_free(T *P) __attribute__ ((visibility("hidden")));
 
+
+/**
+ * Close the ResultSet of this PreparedStatement, if any, and discard
+ * bound and batched parameters so the statement can be kept and reused
+ * by the next user of the Connection
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_clear(T P) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Tell the PreparedStatement that the server deallocated it when the 
+ * session was reset, so it is freed without a round-trip to the database
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_discard(T P) __attribute__ ((visibility("hidden")));
+
+
+/**
+ * Execute batches of this PreparedStatement as multi-row INSERT statements
+ * if <code>sql</code> is a single-row INSERT with all parameters in its
+ * VALUES tuple. Otherwise batches are executed as before.
+ * @param P A PreparedStatement object
+ * @param C The Connection used to prepare the multi-row statements
+ * @param sql The SQL statement P was prepared from
+ */
+void PreparedStatement_setBatchRewrite(T P, struct Connection_S *C, const char *sql) __attribute__ ((visibility("hidden")));
+
 //>> End Protected methods
 
 /** @name Parameters */
@@ -385,6 +436,57 @@ ResultSet_T PreparedStatement_executeQuery(T P);
  */
 long long PreparedStatement_rowsChanged(T P);
 
+/** @name Batch */
+//@{
+
+/**
+ * Adds the current <i>in</i> parameter values to this PreparedStatement's
+ * batch. String and blob values are copied. Parameters keep their values
+ * so only those which change need to be set before the next entry is added.
+ * A parameter which was never set is NULL.
+ * @param P A PreparedStatement object
+ * @see PreparedStatement_executeBatch
+ */
+void PreparedStatement_addBatch(T P);
+
+
+/**
+ * Executes each entry in the batch, in the order they were added, and
+ * clears the batch. The statement cannot return a ResultSet. If an entry
+ * fails, an SQLException is thrown and the batch is cleared. Whether
+ * entries before the failed entry are kept is database dependent; execute
+ * the batch in a transaction to get all-or-nothing behavior. After this
+ * method returns or throws, all <i>in</i> parameters are NULL and must
+ * be set again.
+ * @param P A PreparedStatement object
+ * @return The number of entries executed, 0 if the batch is empty
+ * @exception SQLException If a database error occurs
+ * @see PreparedStatement_getBatchRowsChanged
+ */
+int PreparedStatement_executeBatch(T P);
+
+
+/**
+ * Returns the number of rows changed by an entry in the last batch
+ * executed.
+ * @param P A PreparedStatement object
+ * @param index The first entry is 1, the second is 2,..
+ * @return The number of rows inserted, deleted or modified by the entry, or
+ * -1 if the database executed the batch as one operation without reporting
+ * the count for each entry. PreparedStatement_rowsChanged() then returns
+ * the total
+ * @exception SQLException If index is outside the last batch
+ */
+long long PreparedStatement_getBatchRowsChanged(T P, int index);
+
+
+/**
+ * Discards all entries in the batch without executing them
+ * @param P A PreparedStatement object
+ */
+void PreparedStatement_clearBatch(T P);
+
+//@}
 
 /** @name Properties */
 //@{
@@ -396,6 +498,14 @@ long long PreparedStatement_rowsChanged(T P);
  */
 int PreparedStatement_getParameterCount(T P);
 
+
+/**
+ * Returns the number of entries added to the batch and not yet executed.
+ * @param P A PreparedStatement object
+ * @return The number of entries in the batch
+ */
+int PreparedStatement_getBatchSize(T P);
+
 //@}
 
 #undef T
@@ -36,6 +36,43 @@
 #define T PreparedStatementDelegate_T
 typedef struct T *T;
 
+/**
+ * A parameter value in a batch. String and blob values are copies owned
+ * by the PreparedStatement and stay valid until the batch is executed
+ */
+typedef struct BatchValue_T {
+        enum {
+                Batch_null = 0,
+                Batch_string,
+                Batch_int,
+                Batch_uint,
+                Batch_double,
+                Batch_timestamp,
+                Batch_blob
+        } type;
+        int size; // Length of a string or blob value
+        union {
+                long long i;
+                unsigned long long u;
+                double d;
+                time_t t;
+                void *p;
+        } v;
+} *BatchValue_T;
+
+/**
+ * The entries added with PreparedStatement_addBatch(). A delegate's
+ * executeBatch executes each entry in order and sets the number of rows
+ * changed by the entry in rowsChanged, or -1 if the database does not
+ * report it for each entry
+ */
+typedef struct Batch_T {
+        int rows;               // Number of entries in the batch
+        int columns;            // Number of parameters in each entry
+        BatchValue_T values;    // rows * columns values, entry by entry
+        long long *rowsChanged; // rows counts, set by executeBatch
+} *Batch_T;
+
 typedef struct Pop_T {
         const char *name;
         void (*free)(T *P);
@@ -56,6 +93,10 @@ typedef struct Pop_T {
         ResultSet_T (*executeQuery)(T P);
         long long (*rowsChanged)(T P);
         int (*parameterCount)(T P);
+        // Optional, PreparedStatement executes each entry if not implemented
+        void (*executeBatch)(T P, Batch_T batch);
+        // Optional, the session was reset and the server deallocated the statement
+        void (*discard)(T P);
 } *Pop_T;
 
 /**
@@ -70,5 +111,29 @@ static inline int checkAndSetParameterIndex(int parameterIndex, int parameterCou
         return i;
 }
 
+/**
+ * @return The value of parameter column (starting with 0) in entry row
+ */
+static inline BatchValue_T batchValue(Batch_T batch, int row, int column) {
+        return &batch->values[row * batch->columns + column];
+}
+
+/**
+ * @return The type of the non-NULL values in a batch column (starting with
+ * 0), Batch_null if all are NULL or -1 if the types differ
+ */
+static inline int batchColumnType(Batch_T batch, int column) {
+        int type = Batch_null;
+        for (int row = 0; row < batch->rows; row++) {
+                int t = batchValue(batch, row, column)->type;
+                if (t == Batch_null || t == type)
+                        continue;
+                if (type != Batch_null)
+                        return -1;
+                type = t;
+        }
+        return type;
+}
+
 #undef T
 #endif
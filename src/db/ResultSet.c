@@ -149,6 +149,8 @@ const char *ResultSet_getStringByName(T R, const char *columnName) {
 
 int ResultSet_getInt(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getLLong)
+                return (int)R->op->getLLong(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseInt(s) : 0;
 }
@@ -162,6 +164,8 @@ int ResultSet_getIntByName(T R, const char *columnName) {
 
 long long ResultSet_getLLong(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getLLong)
+                return R->op->getLLong(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseLLong(s) : 0;
 }
@@ -175,6 +179,8 @@ long long ResultSet_getLLongByName(T R, const char *columnName) {
 
 double ResultSet_getDouble(T R, int columnIndex) {
 	assert(R);
+        if (R->op->getDouble)
+                return R->op->getDouble(R->D, columnIndex);
         const char *s = R->op->getString(R->D, columnIndex);
 	return s ? Str_parseDouble(s) : 0.0;
 }
@@ -49,6 +49,8 @@ typedef struct Rop_T {
         bool (*isnull)(T R, int columnIndex);
         const char *(*getString)(T R, int columnIndex);
         const void *(*getBlob)(T R, int columnIndex, int *size);
+        long long (*getLLong)(T R, int columnIndex);
+        double (*getDouble)(T R, int columnIndex);
         time_t (*getTimestamp)(T R, int columnIndex);
         struct tm *(*getDateTime)(T R, int columnIndex, struct tm *tm);
 } *Rop_T;
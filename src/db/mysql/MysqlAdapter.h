@@ -31,5 +31,7 @@
 
 ResultSetDelegate_T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) __attribute__ ((visibility("hidden")));
 PreparedStatementDelegate_T MysqlPreparedStatement_new(Connection_T delegator, MYSQL_STMT *stmt) __attribute__ ((visibility("hidden")));
+BulkLoaderDelegate_T MysqlBulkLoader_new(Connection_T delegator, MYSQL *db, const char *table, const char *columns) __attribute__ ((visibility("hidden")));
+void MysqlBulkLoader_setLocalInfile(MYSQL *db, BulkLoaderDelegate_T L) __attribute__ ((visibility("hidden")));
 
 #endif
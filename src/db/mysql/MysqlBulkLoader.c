@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errmsg.h>
+
+#include "system/Time.h"
+#include "MysqlAdapter.h"
+
+
+/**
+ * Implementation of the BulkLoader/Delegate interface for mysql. Each chunk
+ * of rows is sent with LOAD DATA LOCAL INFILE, where the "file" is read
+ * from memory by a local infile handler. The handler refuses to read files
+ * when no bulk load is in progress, so a server cannot request local files.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- Definitions */
+
+
+#define T BulkLoaderDelegate_T
+struct T {
+        MYSQL *db;
+        char *sql;
+        char *buffer;
+        int length;
+        int capacity;
+        int offset;
+        Connection_T delegator;
+};
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+static int _infileInit(void **ptr, const char *filename, void *userdata) {
+        T L = *ptr = userdata;
+        if (! L)
+                return 1;
+        L->offset = 0;
+        return 0;
+}
+
+
+static int _infileRead(void *ptr, char *buf, unsigned int size) {
+        T L = ptr;
+        int n = L->length - L->offset;
+        if (n > (int)size)
+                n = (int)size;
+        memcpy(buf, L->buffer + L->offset, n);
+        L->offset += n;
+        return n;
+}
+
+
+static void _infileEnd(void *ptr) {
+}
+
+
+static int _infileError(void *ptr, char *error_msg, unsigned int error_msg_len) {
+        snprintf(error_msg, error_msg_len, "LOAD DATA LOCAL INFILE is only allowed with Connection_bulkLoad()");
+        return CR_UNKNOWN_ERROR;
+}
+
+
+/* Returns a pointer to room for at least n more bytes at the end of the buffer */
+static char *_reserve(T L, int n) {
+        if (L->length + n > L->capacity) {
+                L->capacity = (L->length + n) * 2;
+                if (L->buffer)
+                        RESIZE(L->buffer, L->capacity);
+                else
+                        L->buffer = ALLOC(L->capacity);
+        }
+        return L->buffer + L->length;
+}
+
+
+static inline void _put(T L, char c) {
+        *_reserve(L, 1) = c;
+        L->length++;
+}
+
+
+/* Escape the characters LOAD DATA's default FIELDS ESCAPED BY '\\' interprets */
+static char *_escape(char *p, const char *s, int size) {
+        for (int i = 0; i < size; i++) {
+                switch (s[i]) {
+                        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+                        case '\t': *p++ = '\\'; *p++ = 't'; break;
+                        case '\n': *p++ = '\\'; *p++ = 'n'; break;
+                        case '\r': *p++ = '\\'; *p++ = 'r'; break;
+                        case '\0': *p++ = '\\'; *p++ = '0'; break;
+                        default: *p++ = s[i]; break;
+                }
+        }
+        return p;
+}
+
+
+static void _encode(T L, BatchValue_T v) {
+        char *p;
+        switch (v->type) {
+                case Batch_string:
+                case Batch_blob:
+                        p = _escape(_reserve(L, 2 * v->size), v->v.p, v->size);
+                        break;
+                case Batch_int:
+                        p = _reserve(L, 24);
+                        p += snprintf(p, 24, "%lld", v->v.i);
+                        break;
+                case Batch_uint:
+                        p = _reserve(L, 24);
+                        p += snprintf(p, 24, "%llu", v->v.u);
+                        break;
+                case Batch_double:
+                        p = _reserve(L, 32);
+                        p += snprintf(p, 32, "%.17g", v->v.d);
+                        break;
+                case Batch_timestamp:
+                        p = _reserve(L, 20);
+                        p += strlen(Time_toString(v->v.t, p));
+                        break;
+                default:
+                        p = _reserve(L, 2);
+                        *p++ = '\\'; *p++ = 'N';
+                        break;
+        }
+        L->length = (int)(p - L->buffer);
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+void MysqlBulkLoader_setLocalInfile(MYSQL *db, T L) {
+        mysql_set_local_infile_handler(db, _infileInit, _infileRead, _infileEnd, _infileError, L);
+}
+
+
+/* ------------------------------------------------------------- Constructor */
+
+
+T MysqlBulkLoader_new(Connection_T delegator, MYSQL *db, const char *table, const char *columns) {
+        T L;
+        assert(db);
+        assert(table);
+        assert(columns);
+        NEW(L);
+        L->delegator = delegator;
+        L->db = db;
+        L->sql = Str_cat("LOAD DATA LOCAL INFILE 'libzdb' INTO TABLE %s CHARACTER SET %s (%s);", table, mysql_character_set_name(db), columns);
+        return L;
+}
+
+
+/* -------------------------------------------------------- Delegate Methods */
+
+
+static void _free(T *L) {
+        assert(L && *L);
+        FREE((*L)->sql);
+        FREE((*L)->buffer);
+        FREE(*L);
+}
+
+
+static void _load(T L, Batch_T rows) {
+        assert(L);
+        L->length = 0;
+        for (int row = 0; row < rows->rows; row++) {
+                for (int i = 0; i < rows->columns; i++) {
+                        if (i)
+                                _put(L, '\t');
+                        _encode(L, batchValue(rows, row, i));
+                }
+                _put(L, '\n');
+        }
+        MysqlBulkLoader_setLocalInfile(L->db, L);
+        int status = mysql_real_query(L->db, L->sql, strlen(L->sql));
+        MysqlBulkLoader_setLocalInfile(L->db, NULL);
+        if (status)
+                THROW(SQLException, "%s", mysql_error(L->db));
+        // With LOCAL, rows the server cannot load are skipped with a warning instead of failing the statement
+        long long loaded = (long long)mysql_affected_rows(L->db);
+        if (loaded != rows->rows)
+                THROW(SQLException, "Bulk load rejected %lld of %d rows, see SHOW WARNINGS", rows->rows - loaded, rows->rows);
+}
+
+
+static void _finish(T L) {
+        assert(L);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+const struct Lop_T mysqllops = {
+        .name   = "mysql",
+        .free   = _free,
+        .load   = _load,
+        .finish = _finish
+};
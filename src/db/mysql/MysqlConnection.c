@@ -49,12 +49,14 @@
 struct T {
         MYSQL *db;
         int lastError;
+        long maxPacket;
         StringBuffer_T sb;
         Connection_T delegator;
 };
 #define MYSQL_OK 0
 extern const struct Rop_T mysqlrops;
 extern const struct Pop_T mysqlpops;
+extern const struct Lop_T mysqllops;
 
 
 /* --------------------------------------------------------- Private methods */
@@ -64,6 +66,7 @@ static MYSQL *_doConnect(Connection_T delegator, char **error) {
 #define ERROR(e) do {*error = Str_dup(e); goto error;} while (0)
         URL_T url = Connection_getURL(delegator);
         bool yes = 1;
+        unsigned int localInfile = 1;
         int connectTimeout = SQL_DEFAULT_TIMEOUT / MSEC_PER_SEC;
         unsigned long clientFlags = CLIENT_MULTI_STATEMENTS;
         MYSQL *db = mysql_init(NULL);
@@ -79,13 +82,13 @@ static MYSQL *_doConnect(Connection_T delegator, char **error) {
         if (! password)
                 if (! (password = URL_getParameter(url, "password")))
                         ERROR("no password specified in URL");
-        const char *host = URL_getHost(url);
+        const char *host = Connection_getHost(delegator);
         const char *unix_socket = URL_getParameter(url, "unix-socket");
         if (unix_socket) {
                 host = "localhost"; // Make sure host is localhost if unix socket is to be used
         } else if (! host)
                 ERROR("no host specified in URL");
-        int port = URL_getPort(url);
+        int port = Connection_getPort(delegator);
         if (port <= 0)
                 ERROR("no port specified in URL");
         const char *database = URL_getPath(url);
@@ -120,6 +123,9 @@ static MYSQL *_doConnect(Connection_T delegator, char **error) {
 #if MYSQL_VERSION_ID >= 50013
         mysql_options(db, MYSQL_OPT_RECONNECT, &yes);
 #endif
+        // Local files are only read from memory by a bulk load, see MysqlBulkLoader.c
+        mysql_options(db, MYSQL_OPT_LOCAL_INFILE, &localInfile);
+        MysqlBulkLoader_setLocalInfile(db, NULL);
         // Set Connection ResultSet fetch size if found in URL
         const char *fetchSize = URL_getParameter(url, "fetch-size");
         if (fetchSize) {
@@ -275,6 +281,12 @@ static PreparedStatement_T _prepareStatement(T C, const char *sql, va_list ap) {
 }
 
 
+static BulkLoader_T _bulkLoad(T C, const char *table, const char *columns, int columnCount) {
+        assert(C);
+        return BulkLoader_new(MysqlBulkLoader_new(C->delegator, C->db, table, columns), (Lop_T)&mysqllops, columnCount);
+}
+
+
 static const char *_getLastError(T C) {
         assert(C);
         if (mysql_errno(C->db))
@@ -283,6 +295,116 @@ static const char *_getLastError(T C) {
 }
 
 
+/* Run a query and return the stored result or NULL on error */
+static MYSQL_RES *_query(T C, const char *sql) {
+        StringBuffer_set(C->sb, "%s", sql);
+        if ((C->lastError = mysql_real_query(C->db, sql, strlen(sql))) != MYSQL_OK)
+                return NULL;
+        return mysql_store_result(C->db);
+}
+
+
+static long long _replicationLag(T C) {
+        assert(C);
+        long long lag = -1;
+        MYSQL_RES *res = _query(C, "SHOW REPLICA STATUS");
+        if (! res)
+                res = _query(C, "SHOW SLAVE STATUS"); // Before MySQL 8.0.22 and MariaDB
+        if (res) {
+                MYSQL_ROW row = mysql_fetch_row(res);
+                if (! row) {
+                        lag = 0; // Not a replica
+                } else {
+                        MYSQL_FIELD *fields = mysql_fetch_fields(res);
+                        for (unsigned int i = 0; i < mysql_num_fields(res); i++) {
+                                if (Str_isEqual(fields[i].name, "Seconds_Behind_Source") || Str_isEqual(fields[i].name, "Seconds_Behind_Master")) {
+                                        // NULL if replication is not running
+                                        if (row[i])
+                                                lag = Str_parseLLong(row[i]) * MSEC_PER_SEC;
+                                        break;
+                                }
+                        }
+                }
+                mysql_free_result(res);
+        }
+        return lag;
+}
+
+
+static char *_replicationPosition(T C) {
+        assert(C);
+        char *gtid = NULL;
+        MYSQL_RES *res = _query(C, "SELECT @@GLOBAL.gtid_executed");
+        if (res) {
+                MYSQL_ROW row = mysql_fetch_row(res);
+                gtid = Str_dup(row && row[0] ? row[0] : "");
+                mysql_free_result(res);
+        }
+        return gtid;
+}
+
+
+static bool _hasReplayed(T C, const char *position) {
+        assert(C);
+        bool replayed = false;
+        // A GTID set only contains uuids, intervals and separators, so it can be inlined safely
+        for (const char *p = position; *p; p++)
+                if (! (isxdigit((unsigned char)*p) || *p == '-' || *p == ':' || *p == ',' || isspace((unsigned char)*p)))
+                        return false;
+        StringBuffer_set(C->sb, "SELECT GTID_SUBSET('%s', @@GLOBAL.gtid_executed)", position);
+        const char *sql = StringBuffer_toString(C->sb);
+        if ((C->lastError = mysql_real_query(C->db, sql, strlen(sql))) == MYSQL_OK) {
+                MYSQL_RES *res = mysql_store_result(C->db);
+                if (res) {
+                        MYSQL_ROW row = mysql_fetch_row(res);
+                        replayed = row && row[0] && *row[0] == '1';
+                        mysql_free_result(res);
+                }
+        }
+        return replayed;
+}
+
+
+static bool _reset(T C) {
+        assert(C);
+#if MYSQL_VERSION_ID >= 50703
+        C->lastError = mysql_reset_connection(C->db);
+        return (C->lastError == MYSQL_OK);
+#else
+        return true;
+#endif
+}
+
+
+static long long _sessionId(T C) {
+        assert(C);
+        return (long long)mysql_thread_id(C->db);
+}
+
+
+static int _maxParameters(T C) {
+        assert(C);
+        return 65535;
+}
+
+
+static long _maxPacket(T C) {
+        assert(C);
+        if (! C->maxPacket) {
+                MYSQL_RES *res = _query(C, "SELECT @@max_allowed_packet");
+                if (res) {
+                        MYSQL_ROW row = mysql_fetch_row(res);
+                        if (row && row[0])
+                                C->maxPacket = (long)Str_parseLLong(row[0]);
+                        mysql_free_result(res);
+                }
+                if (! C->maxPacket)
+                        C->maxPacket = 1048576; // The server default before MySQL 8
+        }
+        return C->maxPacket;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -300,6 +422,14 @@ const struct Cop_T mysqlcops = {
         .execute	  = _execute,
         .executeQuery     = _executeQuery,
         .prepareStatement = _prepareStatement,
-        .getLastError     = _getLastError
+        .bulkLoad         = _bulkLoad,
+        .getLastError     = _getLastError,
+        .replicationLag   = _replicationLag,
+        .replicationPosition = _replicationPosition,
+        .hasReplayed      = _hasReplayed,
+        .reset            = _reset,
+        .sessionId        = _sessionId,
+        .maxParameters    = _maxParameters,
+        .maxPacket        = _maxPacket
 };
 
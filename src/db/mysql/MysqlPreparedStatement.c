@@ -275,6 +275,167 @@ static void _execute(T P) {
 }
 
 
+#if defined(MARIADB_PACKAGE_VERSION_ID) && MARIADB_PACKAGE_VERSION_ID >= 30000
+
+static void _bindValue(T P, int parameterIndex, BatchValue_T v) {
+        switch (v->type) {
+                case Batch_string:
+                        _setString(P, parameterIndex, v->v.p);
+                        break;
+                case Batch_int:
+                        _setInt64(P, parameterIndex, v->v.i);
+                        break;
+                case Batch_uint:
+                        _setUInt64(P, parameterIndex, v->v.u);
+                        break;
+                case Batch_double:
+                        _setDouble(P, parameterIndex, v->v.d);
+                        break;
+                case Batch_timestamp:
+                        _setTimestamp(P, parameterIndex, v->v.t);
+                        break;
+                case Batch_blob:
+                        _setBlob(P, parameterIndex, v->v.p, v->size);
+                        break;
+                default:
+                        _setString(P, parameterIndex, NULL);
+                        break;
+        }
+}
+
+
+static bool _hasBulkOperations(T P) {
+        unsigned long capabilities = 0;
+        if (mariadb_get_infov(P->stmt->mysql, MARIADB_CONNECTION_EXTENDED_SERVER_CAPABILITIES, &capabilities))
+                return false;
+        return (capabilities & (MARIADB_CLIENT_STMT_BULK_OPERATIONS >> 32));
+}
+
+
+static void _executeRows(T P, Batch_T batch) {
+        for (int row = 0; row < batch->rows; row++) {
+                for (int i = 0; i < batch->columns; i++)
+                        _bindValue(P, i + 1, batchValue(batch, row, i));
+                _execute(P);
+                batch->rowsChanged[row] = (long long)mysql_stmt_affected_rows(P->stmt);
+        }
+}
+
+
+/* Bind a batch column as arrays of values, lengths and NULL indicators */
+static void _bindColumn(MYSQL_BIND *bind, Batch_T batch, int column, int type) {
+        int rows = batch->rows;
+        bind->u.indicator = CALLOC(rows, sizeof(char));
+        switch (type) {
+                case Batch_string:
+                case Batch_blob:
+                        bind->buffer_type = type == Batch_string ? MYSQL_TYPE_STRING : MYSQL_TYPE_BLOB;
+                        bind->buffer = CALLOC(rows, sizeof(char *));
+                        bind->length = CALLOC(rows, sizeof(unsigned long));
+                        break;
+                case Batch_int:
+                case Batch_uint:
+                        bind->buffer_type = MYSQL_TYPE_LONGLONG;
+                        bind->buffer = CALLOC(rows, sizeof(long long));
+                        bind->is_unsigned = type == Batch_uint;
+                        break;
+                case Batch_double:
+                        bind->buffer_type = MYSQL_TYPE_DOUBLE;
+                        bind->buffer = CALLOC(rows, sizeof(double));
+                        break;
+                case Batch_timestamp:
+                        bind->buffer_type = MYSQL_TYPE_TIMESTAMP;
+                        bind->buffer = CALLOC(rows, sizeof(MYSQL_TIME));
+                        break;
+                default:
+                        bind->buffer_type = MYSQL_TYPE_NULL;
+                        break;
+        }
+        for (int row = 0; row < rows; row++) {
+                BatchValue_T v = batchValue(batch, row, column);
+                if (v->type == Batch_null) {
+                        bind->u.indicator[row] = STMT_INDICATOR_NULL;
+                        continue;
+                }
+                switch (type) {
+                        case Batch_string:
+                        case Batch_blob:
+                                ((char **)bind->buffer)[row] = v->v.p;
+                                bind->length[row] = v->size;
+                                break;
+                        case Batch_int:
+                        case Batch_uint:
+                                ((long long *)bind->buffer)[row] = v->v.i;
+                                break;
+                        case Batch_double:
+                                ((double *)bind->buffer)[row] = v->v.d;
+                                break;
+                        case Batch_timestamp:
+                        {
+                                struct tm ts = {.tm_isdst = -1};
+                                MYSQL_TIME *t = &((MYSQL_TIME *)bind->buffer)[row];
+                                gmtime_r(&v->v.t, &ts);
+                                t->year = ts.tm_year + 1900;
+                                t->month = ts.tm_mon + 1;
+                                t->day = ts.tm_mday;
+                                t->hour = ts.tm_hour;
+                                t->minute = ts.tm_min;
+                                t->second = ts.tm_sec;
+                                t->time_type = MYSQL_TIMESTAMP_DATETIME;
+                        }
+                                break;
+                }
+        }
+}
+
+
+/* MariaDB array binding sends all entries in one execute. The server only
+ reports the total rows changed. Entries are executed one by one if the
+ server does not support bulk operations or a column has mixed types */
+static void _executeBatch(T P, Batch_T batch) {
+        assert(P);
+        bool bulk = batch->columns > 0 && _hasBulkOperations(P);
+        for (int i = 0; bulk && i < batch->columns; i++)
+                bulk = batchColumnType(batch, i) >= 0;
+        if (! bulk) {
+                _executeRows(P, batch);
+                return;
+        }
+        unsigned int rows = batch->rows;
+        MYSQL_BIND *bind = CALLOC(batch->columns, sizeof(MYSQL_BIND));
+        TRY
+        {
+                for (int i = 0; i < batch->columns; i++)
+                        _bindColumn(&bind[i], batch, i, batchColumnType(batch, i));
+#if MYSQL_VERSION_ID >= 50002
+                unsigned long cursor = CURSOR_TYPE_NO_CURSOR;
+                mysql_stmt_attr_set(P->stmt, STMT_ATTR_CURSOR_TYPE, &cursor);
+#endif
+                mysql_stmt_attr_set(P->stmt, STMT_ATTR_ARRAY_SIZE, &rows);
+                if ((P->lastError = mysql_stmt_bind_param(P->stmt, bind)) || (P->lastError = mysql_stmt_execute(P->stmt)))
+                        THROW(SQLException, "%s", mysql_stmt_error(P->stmt));
+                long long changed = (long long)mysql_stmt_affected_rows(P->stmt);
+                for (int row = 0; row < batch->rows; row++)
+                        batch->rowsChanged[row] = changed ? -1 : 0;
+        }
+        FINALLY
+        {
+                rows = 0;
+                mysql_stmt_attr_set(P->stmt, STMT_ATTR_ARRAY_SIZE, &rows);
+                mysql_stmt_reset(P->stmt);
+                for (int i = 0; i < batch->columns; i++) {
+                        FREE(bind[i].u.indicator);
+                        FREE(bind[i].buffer);
+                        FREE(bind[i].length);
+                }
+                FREE(bind);
+        }
+        END_TRY;
+}
+
+#endif
+
+
 static ResultSet_T _executeQuery(T P) {
         assert(P);
         if (P->parameterCount > 0) {
@@ -327,6 +488,9 @@ const struct Pop_T mysqlpops = {
         .execute        = _execute,
         .executeQuery   = _executeQuery,
         .rowsChanged    = _rowsChanged,
-        .parameterCount = _parameterCount
+        .parameterCount = _parameterCount,
+#if defined(MARIADB_PACKAGE_VERSION_ID) && MARIADB_PACKAGE_VERSION_ID >= 30000
+        .executeBatch   = _executeBatch
+#endif
 };
 
@@ -26,7 +26,9 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <errmsg.h>
 
 #include "MysqlAdapter.h"
@@ -36,6 +38,11 @@
  * Implementation of the ResultSet/Delegate interface for mysql. 
  * Accessing columns with index outside range throws SQLException
  *
+ * Integer, floating point and temporal columns are bound to native values
+ * so they are read without conversion to and from text. Such a value is 
+ * only formatted as text if getString() is called for it. Other columns, 
+ * and zerofill columns whose text is padded, are bound to a string buffer.
+ *
  * @file
  */
 
@@ -44,8 +51,16 @@
 
 
 #define MYSQL_OK 0
+#define NATIVE_SIZE 64 // Text buffer of a natively bound column
 typedef struct column_t {
         char *buffer;
+        enum enum_field_types type; // As bound
+        union {
+                long long i;
+                float f;
+                double d;
+                MYSQL_TIME t;
+        } value;
 #if MYSQL_VERSION_ID < 80000 || MARIADB_VERSION_ID
         my_bool is_null;
 #else
@@ -62,6 +77,7 @@ struct T {
         int fetchSize;
         int lastError;
         int needRebind;
+        unsigned long columnBuffer;
         int currentRow;
         int columnCount;
         MYSQL_RES *meta;
@@ -76,11 +92,15 @@ struct T {
 
 
 static inline void _ensureCapacity(T R, int i) {
-        if ((R->columns[i].real_length > R->bind[i].buffer_length)) {
-                /* Column was truncated, resize and fetch column directly. */
-                RESIZE(R->columns[i].buffer, R->columns[i].real_length + 1);
+        if (R->columns[i].type == MYSQL_TYPE_STRING && (R->columns[i].real_length > R->bind[i].buffer_length)) {
+                /* Column was truncated, resize and fetch column directly. The buffer
+                 is at least doubled so a column with growing values is seldom rebound */
+                unsigned long size = R->bind[i].buffer_length * 2;
+                if (size < R->columns[i].real_length)
+                        size = R->columns[i].real_length;
+                RESIZE(R->columns[i].buffer, size + 1);
                 R->bind[i].buffer = R->columns[i].buffer;
-                R->bind[i].buffer_length = R->columns[i].real_length;
+                R->bind[i].buffer_length = size;
                 if ((R->lastError = mysql_stmt_fetch_column(R->stmt, &R->bind[i], i, 0)))
                         THROW(SQLException, "mysql_stmt_fetch_column -- %s", mysql_stmt_error(R->stmt));
                 R->needRebind = true;
@@ -89,6 +109,117 @@ static inline void _ensureCapacity(T R, int i) {
 static void _setFetchSize(T R, int rows);
 
 
+static void _bindColumn(T R, int i) {
+        column_t c = &R->columns[i];
+        c->field = mysql_fetch_field_direct(R->meta, i);
+        switch ((c->field->flags & ZEROFILL_FLAG) ? MYSQL_TYPE_STRING : c->field->type) {
+                case MYSQL_TYPE_TINY:
+                case MYSQL_TYPE_SHORT:
+                case MYSQL_TYPE_INT24:
+                case MYSQL_TYPE_LONG:
+                case MYSQL_TYPE_LONGLONG:
+                case MYSQL_TYPE_YEAR:
+                        c->type = MYSQL_TYPE_LONGLONG;
+                        R->bind[i].buffer = &c->value.i;
+                        R->bind[i].is_unsigned = (c->field->flags & UNSIGNED_FLAG) != 0;
+                        break;
+                case MYSQL_TYPE_FLOAT:
+                        c->type = MYSQL_TYPE_FLOAT;
+                        R->bind[i].buffer = &c->value.f;
+                        break;
+                case MYSQL_TYPE_DOUBLE:
+                        c->type = MYSQL_TYPE_DOUBLE;
+                        R->bind[i].buffer = &c->value.d;
+                        break;
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_TIME:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_TIMESTAMP:
+                        c->type = c->field->type;
+                        R->bind[i].buffer = &c->value.t;
+                        break;
+                default:
+                {
+                        // Size the buffer from the column's maximum length, known for stored results, or its defined length
+                        unsigned long size = c->field->max_length ? c->field->max_length : c->field->length;
+                        if (size == 0)
+                                size = STRLEN;
+                        if (size > R->columnBuffer)
+                                size = R->columnBuffer;
+                        c->type = MYSQL_TYPE_STRING;
+                        c->buffer = ALLOC(size + 1);
+                        R->bind[i].buffer = c->buffer;
+                        R->bind[i].buffer_length = size;
+                        break;
+                }
+        }
+        if (! c->buffer)
+                c->buffer = ALLOC(NATIVE_SIZE);
+        R->bind[i].buffer_type = c->type;
+        R->bind[i].is_null = &c->is_null;
+        R->bind[i].length = &c->real_length;
+}
+
+
+/* Format a floating point value with the fewest digits that read back as
+ the same value, like the server does. Fixed notation is used for exponents
+ from -4 up to threshold, 15 for double and 6 for float */
+static const char *_formatDouble(column_t c, double d, bool isFloat) {
+        int p = 1;
+        for (; p < 17; p++) {
+                snprintf(c->buffer, NATIVE_SIZE, "%.*e", p - 1, d);
+                if (isFloat ? strtof(c->buffer, NULL) == (float)d : strtod(c->buffer, NULL) == d)
+                        break;
+        }
+        snprintf(c->buffer, NATIVE_SIZE, "%.*e", p - 1, d);
+        char *e = strchr(c->buffer, 'e');
+        int exponent = atoi(e + 1);
+        if (exponent >= -4 && exponent < (isFloat ? 6 : 15))
+                snprintf(c->buffer, NATIVE_SIZE, "%.*f", p - 1 - exponent > 0 ? p - 1 - exponent : 0, d);
+        else
+                snprintf(e, NATIVE_SIZE - (e - c->buffer), "e%d", exponent);
+        return c->buffer;
+}
+
+
+/* Format a temporal value as the server does in the text protocol */
+static const char *_formatTime(column_t c) {
+        MYSQL_TIME *t = &c->value.t;
+        int n;
+        if (c->type == MYSQL_TYPE_DATE) {
+                snprintf(c->buffer, NATIVE_SIZE, "%04u-%02u-%02u", t->year, t->month, t->day);
+                return c->buffer;
+        }
+        if (c->type == MYSQL_TYPE_TIME)
+                n = snprintf(c->buffer, NATIVE_SIZE, "%s%02u:%02u:%02u", t->neg ? "-" : "", t->day * 24 + t->hour, t->minute, t->second);
+        else
+                n = snprintf(c->buffer, NATIVE_SIZE, "%04u-%02u-%02u %02u:%02u:%02u", t->year, t->month, t->day, t->hour, t->minute, t->second);
+        if (c->field->decimals > 0 && c->field->decimals <= 6) {
+                unsigned long fraction = t->second_part;
+                for (unsigned int d = c->field->decimals; d < 6; d++)
+                        fraction /= 10;
+                snprintf(c->buffer + n, NATIVE_SIZE - n, ".%0*lu", (int)c->field->decimals, fraction);
+        }
+        return c->buffer;
+}
+
+
+/* Returns true if the column is a date, datetime or timestamp with a valid
+ date or a time of day, which can be read without text conversion */
+static inline bool _isNativeTime(column_t c) {
+        switch (c->type) {
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_TIMESTAMP:
+                        return c->value.t.month > 0 && c->value.t.day > 0;
+                case MYSQL_TYPE_TIME:
+                        return ! c->value.t.neg && c->value.t.day == 0 && c->value.t.hour < 24;
+                default:
+                        return false;
+        }
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
@@ -100,6 +231,13 @@ T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) {
         R->keep = keep;
         R->delegator = delegator;
         R->maxRows = Connection_getMaxRows(R->delegator);
+        R->columnBuffer = SQL_MYSQL_COLUMN_BUFFER;
+        const char *columnBuffer = URL_getParameter(Connection_getURL(R->delegator), "column-buffer");
+        if (columnBuffer) {
+                int size = Str_parseInt(columnBuffer);
+                if (size > 0)
+                        R->columnBuffer = size;
+        }
         R->columnCount = mysql_stmt_field_count(R->stmt);
         if ((R->columnCount <= 0) || ! (R->meta = mysql_stmt_result_metadata(R->stmt))) {
                 DEBUG("Warning: column error - %s\n", mysql_stmt_error(stmt));
@@ -107,15 +245,8 @@ T MysqlResultSet_new(Connection_T delegator, MYSQL_STMT *stmt, int keep) {
         } else {
                 R->bind = CALLOC(R->columnCount, sizeof (MYSQL_BIND));
                 R->columns = CALLOC(R->columnCount, sizeof (struct column_t));
-                for (int i = 0; i < R->columnCount; i++) {
-                        R->columns[i].buffer = ALLOC(STRLEN + 1);
-                        R->bind[i].buffer_type = MYSQL_TYPE_STRING;
-                        R->bind[i].buffer = R->columns[i].buffer;
-                        R->bind[i].buffer_length = STRLEN;
-                        R->bind[i].is_null = &R->columns[i].is_null;
-                        R->bind[i].length = &R->columns[i].real_length;
-                        R->columns[i].field = mysql_fetch_field_direct(R->meta, i);
-                }
+                for (int i = 0; i < R->columnCount; i++)
+                        _bindColumn(R, i);
                 if ((R->lastError = mysql_stmt_bind_result(R->stmt, R->bind))) {
                         DEBUG("Error: bind - %s\n", mysql_stmt_error(stmt));
                         R->stop = true;
@@ -161,10 +292,13 @@ static const char *_getColumnName(T R, int columnIndex) {
 }
 
 
+static const char *_getString(T R, int columnIndex);
 static long _getColumnSize(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (R->columns[i].is_null)
                 return 0;
+        if (R->columns[i].type != MYSQL_TYPE_STRING)
+                return strlen(_getString(R, columnIndex));
         return R->columns[i].real_length;
 }
 
@@ -221,11 +355,24 @@ static bool _isnull(T R, int columnIndex) {
 static const char *_getString(T R, int columnIndex) {
         assert(R);
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
-        if (R->columns[i].is_null)
+        column_t c = &R->columns[i];
+        if (c->is_null)
                 return NULL;
-        _ensureCapacity(R, i);
-        R->columns[i].buffer[R->columns[i].real_length] = 0;
-        return R->columns[i].buffer;
+        switch (c->type) {
+                case MYSQL_TYPE_STRING:
+                        _ensureCapacity(R, i);
+                        c->buffer[c->real_length] = 0;
+                        return c->buffer;
+                case MYSQL_TYPE_LONGLONG:
+                        snprintf(c->buffer, NATIVE_SIZE, R->bind[i].is_unsigned ? "%llu" : "%lld", c->value.i);
+                        return c->buffer;
+                case MYSQL_TYPE_FLOAT:
+                        return _formatDouble(c, c->value.f, true);
+                case MYSQL_TYPE_DOUBLE:
+                        return _formatDouble(c, c->value.d, false);
+                default:
+                        return _formatTime(c);
+        }
 }
 
 
@@ -234,12 +381,106 @@ static const void *_getBlob(T R, int columnIndex, int *size) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (R->columns[i].is_null)
                 return NULL;
+        if (R->columns[i].type != MYSQL_TYPE_STRING) {
+                const char *s = _getString(R, columnIndex);
+                *size = (int)strlen(s);
+                return s;
+        }
         _ensureCapacity(R, i);
         *size = (int)R->columns[i].real_length;
         return R->columns[i].buffer;
 }
 
 
+static long long _getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        column_t c = &R->columns[i];
+        if (c->is_null)
+                return 0;
+        switch (c->type) {
+                case MYSQL_TYPE_LONGLONG:
+                        // An unsigned value out of range is rejected as when parsed below
+                        if (! R->bind[i].is_unsigned || c->value.i >= 0)
+                                return c->value.i;
+                        break;
+                case MYSQL_TYPE_FLOAT:
+                        return (long long)c->value.f;
+                case MYSQL_TYPE_DOUBLE:
+                        return (long long)c->value.d;
+                default:
+                        break;
+        }
+        return Str_parseLLong(_getString(R, columnIndex));
+}
+
+
+static double _getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        column_t c = &R->columns[i];
+        if (c->is_null)
+                return 0.0;
+        switch (c->type) {
+                case MYSQL_TYPE_LONGLONG:
+                        return R->bind[i].is_unsigned ? (double)(unsigned long long)c->value.i : (double)c->value.i;
+                case MYSQL_TYPE_FLOAT:
+                        return c->value.f;
+                case MYSQL_TYPE_DOUBLE:
+                        return c->value.d;
+                default:
+                        return Str_parseDouble(_getString(R, columnIndex));
+        }
+}
+
+
+static time_t _getTimestamp(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        column_t c = &R->columns[i];
+        if (c->is_null)
+                return 0;
+        if (_isNativeTime(c) && c->type != MYSQL_TYPE_TIME) {
+                struct tm tm = {
+                        .tm_year = c->value.t.year - 1900,
+                        .tm_mon = c->value.t.month - 1,
+                        .tm_mday = c->value.t.day,
+                        .tm_hour = c->value.t.hour,
+                        .tm_min = c->value.t.minute,
+                        .tm_sec = c->value.t.second
+                };
+                return timegm(&tm);
+        }
+        const char *s = _getString(R, columnIndex);
+        return STR_DEF(s) ? Time_toTimestamp(s) : 0;
+}
+
+
+static struct tm *_getDateTime(T R, int columnIndex, struct tm *tm) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        column_t c = &R->columns[i];
+        if (c->is_null)
+                return tm;
+        if (_isNativeTime(c)) {
+                *tm = (struct tm){.tm_isdst = -1};
+                if (c->type != MYSQL_TYPE_TIME) {
+                        tm->tm_year = c->value.t.year;
+                        tm->tm_mon = c->value.t.month - 1;
+                        tm->tm_mday = c->value.t.day;
+                }
+                if (c->type != MYSQL_TYPE_DATE) {
+                        tm->tm_hour = c->value.t.hour;
+                        tm->tm_min = c->value.t.minute;
+                        tm->tm_sec = c->value.t.second;
+                }
+                return tm;
+        }
+        const char *s = _getString(R, columnIndex);
+        return STR_DEF(s) ? Time_toDateTime(s, tm) : tm;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -254,7 +495,10 @@ const struct Rop_T mysqlrops = {
         .next           = _next,
         .isnull         = _isnull,
         .getString      = _getString,
-        .getBlob        = _getBlob
-        // getTimestamp and getDateTime is handled in ResultSet
+        .getBlob        = _getBlob,
+        .getLLong       = _getLLong,
+        .getDouble      = _getDouble,
+        .getTimestamp   = _getTimestamp,
+        .getDateTime    = _getDateTime
 };
 
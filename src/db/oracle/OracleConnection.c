@@ -114,8 +114,8 @@ static bool _doConnect(T C, char**  error) {
 #define ORAERROR(e) do{ *error = Str_dup(_getErrorDescription(e)); return false;} while(0)
         URL_T url = Connection_getURL(C->delegator);
         const char *servicename, *username, *password;
-        const char *host = URL_getHost(url);
-        int port = URL_getPort(url);
+        const char *host = Connection_getHost(C->delegator);
+        int port = Connection_getPort(C->delegator);
         if (! (username = URL_getUser(url)))
                 if (! (username = URL_getParameter(url, "user")))
                         ERROR("no username specified in URL");
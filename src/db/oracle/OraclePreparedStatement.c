@@ -50,7 +50,6 @@
 typedef struct param_t {
         union {
                 double real;
-                long integer;
                 const void *blob;
                 const char *string;
                 OCINumber number;
@@ -75,6 +74,7 @@ struct T {
         Thread_T    watchdog;
         char        running;
         ub4         rowsChanged;
+        OCIBind**   batchBinds;
         Connection_T delegator;
 };
 extern const struct Rop_T oraclerops;
@@ -129,6 +129,7 @@ static void _free(T *P) {
                 // (*P)->params[i].bind is freed implicitly when the statement handle is deallocated
                 FREE((*P)->params);
         }
+        FREE((*P)->batchBinds);
         (*P)->svc = NULL;
         if ((*P)->watchdog)
                 Thread_join((*P)->watchdog);
@@ -188,23 +189,11 @@ static void _setTimestamp(T P, int parameterIndex, time_t time) {
 }
 
 
-static void _setInt(T P, int parameterIndex, int x) {
-        assert(P);
-        int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->params[i].type.integer = x;
-        P->params[i].length = sizeof(x);
-        P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, &P->params[i].type.integer,
-                                    (int)P->params[i].length, SQLT_INT, 0, 0, 0, 0, 0, OCI_DEFAULT);
-        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
-                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
-}
-
-
-static void _setLLong(T P, int parameterIndex, long long x) {
+static void _setNumber(T P, int parameterIndex, const void *x, uword size, uword sign) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
         P->params[i].length = sizeof(P->params[i].type.number);
-        P->lastError = OCINumberFromInt(P->err, &x, sizeof(x), OCI_NUMBER_SIGNED, &P->params[i].type.number);
+        P->lastError = OCINumberFromInt(P->err, x, size, sign, &P->params[i].type.number);
         if (P->lastError != OCI_SUCCESS)
                 THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
         P->lastError = OCIBindByPos(P->stmt, &P->params[i].bind, P->err, parameterIndex, &P->params[i].type.number, 
@@ -214,6 +203,51 @@ static void _setLLong(T P, int parameterIndex, long long x) {
 }
 
 
+static void _setInteger(T P, int parameterIndex, long long x) {
+        _setNumber(P, parameterIndex, &x, sizeof(x), OCI_NUMBER_SIGNED);
+}
+
+
+static void _setInt8(T P, int parameterIndex, int8_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt8(T P, int parameterIndex, uint8_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt16(T P, int parameterIndex, int16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt16(T P, int parameterIndex, uint16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt32(T P, int parameterIndex, int32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt32(T P, int parameterIndex, uint32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt64(T P, int parameterIndex, int64_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt64(T P, int parameterIndex, uint64_t x) {
+        _setNumber(P, parameterIndex, &x, sizeof(x), OCI_NUMBER_UNSIGNED);
+}
+
+
 static void _setDouble(T P, int parameterIndex, double x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
@@ -261,6 +295,172 @@ static void _execute(T P) {
 }
 
 
+static void _bindValue(T P, int parameterIndex, BatchValue_T v) {
+        switch (v->type) {
+                case Batch_string:
+                        _setString(P, parameterIndex, v->v.p);
+                        break;
+                case Batch_int:
+                        _setInteger(P, parameterIndex, v->v.i);
+                        break;
+                case Batch_uint:
+                        _setUInt64(P, parameterIndex, v->v.u);
+                        break;
+                case Batch_double:
+                        _setDouble(P, parameterIndex, v->v.d);
+                        break;
+                case Batch_timestamp:
+                        _setTimestamp(P, parameterIndex, v->v.t);
+                        break;
+                case Batch_blob:
+                        _setBlob(P, parameterIndex, v->v.p, v->size);
+                        break;
+                default:
+                        _setString(P, parameterIndex, NULL);
+                        break;
+        }
+}
+
+
+static void _executeRows(T P, Batch_T batch) {
+        for (int row = 0; row < batch->rows; row++) {
+                for (int i = 0; i < batch->columns; i++)
+                        _bindValue(P, i + 1, batchValue(batch, row, i));
+                _execute(P);
+                batch->rowsChanged[row] = P->rowsChanged;
+        }
+}
+
+
+/* Bind a batch column as an array of fixed width values with NULL
+ indicators and, for strings and blobs, lengths */
+static void _bindColumn(T P, Batch_T batch, int column, int type, void **values, sb2 **indicators, ub4 **lengths) {
+        ub4 rows = batch->rows;
+        sb8 width = 1;
+        ub2 dty = SQLT_CHR;
+        switch (type) {
+                case Batch_string:
+                case Batch_blob:
+                        for (int row = 0; row < rows; row++)
+                                if (batchValue(batch, row, column)->size > width)
+                                        width = batchValue(batch, row, column)->size;
+                        dty = type == Batch_string ? SQLT_CHR : SQLT_LNG;
+                        *lengths = CALLOC(rows, sizeof(ub4));
+                        break;
+                case Batch_int:
+                case Batch_uint:
+                        width = sizeof(sb8);
+                        dty = type == Batch_int ? SQLT_INT : SQLT_UIN;
+                        break;
+                case Batch_double:
+                        width = sizeof(double);
+                        dty = SQLT_FLT;
+                        break;
+                case Batch_timestamp:
+                        width = sizeof(OCIDate);
+                        dty = SQLT_ODT;
+                        break;
+        }
+        *values = CALLOC(rows, width);
+        *indicators = CALLOC(rows, sizeof(sb2));
+        for (int row = 0; row < rows; row++) {
+                BatchValue_T v = batchValue(batch, row, column);
+                void *value = (char *)*values + row * width;
+                (*indicators)[row] = v->type == Batch_null ? OCI_IND_NULL : OCI_IND_NOTNULL;
+                if (v->type == Batch_null)
+                        continue;
+                switch (type) {
+                        case Batch_string:
+                        case Batch_blob:
+                                memcpy(value, v->v.p, v->size);
+                                (*lengths)[row] = v->size;
+                                break;
+                        case Batch_int:
+                        case Batch_uint:
+                                *(sb8 *)value = v->v.i;
+                                break;
+                        case Batch_double:
+                                *(double *)value = v->v.d;
+                                break;
+                        case Batch_timestamp:
+                        {
+                                struct tm ts = {.tm_isdst = -1};
+                                gmtime_r(&v->v.t, &ts);
+                                OCIDateSetDate((OCIDate *)value, ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday);
+                                OCIDateSetTime((OCIDate *)value, ts.tm_hour, ts.tm_min, ts.tm_sec);
+                        }
+                                break;
+                }
+        }
+        P->lastError = OCIBindByPos2(P->stmt, &P->batchBinds[column], P->err, column + 1, *values, width, dty, *indicators,
+                                     *lengths, 0, 0, 0, OCI_DEFAULT);
+        if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+}
+
+
+/* Array DML, the batch is executed in one OCIStmtExecute with an iteration
+ for each entry. Entries are executed one by one if a column has mixed types */
+static void _executeBatch(T P, Batch_T batch) {
+        assert(P);
+        bool array = batch->columns > 0;
+        for (int i = 0; array && i < batch->columns; i++)
+                array = batchColumnType(batch, i) >= 0;
+        if (! array) {
+                _executeRows(P, batch);
+                return;
+        }
+        if (! P->batchBinds)
+                P->batchBinds = CALLOC(P->parameterCount, sizeof(OCIBind *));
+        void **values = CALLOC(batch->columns, sizeof(void *));
+        sb2 **indicators = CALLOC(batch->columns, sizeof(sb2 *));
+        ub4 **lengths = CALLOC(batch->columns, sizeof(ub4 *));
+        TRY
+        {
+                for (int i = 0; i < batch->columns; i++)
+                        _bindColumn(P, batch, i, batchColumnType(batch, i), &values[i], &indicators[i], &lengths[i]);
+                ub4 mode = OCI_DEFAULT;
+#ifdef OCI_RETURN_ROW_COUNT_ARRAY
+                mode |= OCI_RETURN_ROW_COUNT_ARRAY;
+#endif
+                P->rowsChanged = 0;
+                if (P->timeout > 0) {
+                        P->countdown = P->timeout;
+                        P->running = true;
+                }
+                P->lastError = OCIStmtExecute(P->svc, P->stmt, P->err, batch->rows, 0, NULL, NULL, mode);
+                P->running = false;
+                if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+                P->lastError = OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &P->rowsChanged, 0, OCI_ATTR_ROW_COUNT, P->err);
+                if (P->lastError != OCI_SUCCESS && P->lastError != OCI_SUCCESS_WITH_INFO)
+                        THROW(SQLException, "%s", OraclePreparedStatement_getLastError(P->lastError, P->err));
+                for (int row = 0; row < batch->rows; row++)
+                        batch->rowsChanged[row] = P->rowsChanged ? -1 : 0;
+#ifdef OCI_RETURN_ROW_COUNT_ARRAY
+                ub8 *counts = NULL;
+                ub4 n = 0;
+                if (OCIAttrGet(P->stmt, OCI_HTYPE_STMT, &counts, &n, OCI_ATTR_DML_ROW_COUNT_ARRAY, P->err) == OCI_SUCCESS && counts) {
+                        for (int row = 0; row < batch->rows && row < n; row++)
+                                batch->rowsChanged[row] = (long long)counts[row];
+                }
+#endif
+        }
+        FINALLY
+        {
+                for (int i = 0; i < batch->columns; i++) {
+                        FREE(values[i]);
+                        FREE(indicators[i]);
+                        FREE(lengths[i]);
+                }
+                FREE(values);
+                FREE(indicators);
+                FREE(lengths);
+        }
+        END_TRY;
+}
+
+
 static ResultSet_T _executeQuery(T P) {
         assert(P);
         P->rowsChanged = 0;
@@ -296,14 +496,21 @@ const struct Pop_T oraclepops = {
         .name           = "oracle",
         .free           = _free,
         .setString      = _setString,
-        .setInt         = _setInt,
-        .setLLong       = _setLLong,
+        .setInt8        = _setInt8,
+        .setUInt8       = _setUInt8,
+        .setInt16       = _setInt16,
+        .setUInt16      = _setUInt16,
+        .setInt32       = _setInt32,
+        .setUInt32      = _setUInt32,
+        .setInt64       = _setInt64,
+        .setUInt64      = _setUInt64,
         .setDouble      = _setDouble,
         .setTimestamp   = _setTimestamp,
         .setBlob        = _setBlob,
         .execute        = _execute,
         .executeQuery   = _executeQuery,
         .rowsChanged    = _rowsChanged,
-        .parameterCount = _parameterCount
+        .parameterCount = _parameterCount,
+        .executeBatch   = _executeBatch
 };
 
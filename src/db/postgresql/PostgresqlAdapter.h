@@ -29,7 +29,51 @@
 
 #include "zdb.h"
 
-ResultSetDelegate_T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) __attribute__ ((visibility("hidden")));
-PreparedStatementDelegate_T PostgresqlPreparedStatement_new(Connection_T delegator, PGconn *db, char *stmt, int parameterCount) __attribute__ ((visibility("hidden")));
+#ifdef LIBPQ_HAS_PIPELINING
+#define PIPELINED(db) (PQpipelineStatus(db) != PQ_PIPELINE_OFF)
+#else
+#define PIPELINED(db) false
+#endif
+
+// Type OIDs from the server's catalog/pg_type_d.h, which is not installed with libpq
+#define BOOLOID         16
+#define BYTEAOID        17
+#define CHAROID         18
+#define NAMEOID         19
+#define INT8OID         20
+#define INT2OID         21
+#define INT4OID         23
+#define TEXTOID         25
+#define OIDOID          26
+#define JSONOID         114
+#define FLOAT4OID       700
+#define FLOAT8OID       701
+#define BPCHAROID       1042
+#define VARCHAROID      1043
+#define TIMESTAMPOID    1114
+#define TIMESTAMPTZOID  1184
+#define NUMERICOID      1700
+#define UUIDOID         2950
+
+// Seconds from the Unix epoch to the PostgreSQL epoch, 2000-01-01
+#define POSTGRES_EPOCH 946684800LL
+
+// A fetch size set on the Connection means rows are streamed, see PostgresqlResultSet.c
+#define STREAMING(delegator, db) (Connection_isFetchSizeSet(delegator) && ! PIPELINED(db))
+#ifdef LIBPQ_HAS_CHUNK_MODE
+#define PARTIAL(status) ((status) == PGRES_SINGLE_TUPLE || (status) == PGRES_TUPLES_CHUNK)
+#else
+#define PARTIAL(status) ((status) == PGRES_SINGLE_TUPLE)
+#endif
+
+ResultSetDelegate_T PostgresqlResultSet_new(Connection_T delegator, PGconn *db, PGresult *res) __attribute__ ((visibility("hidden")));
+PGresult *PostgresqlResultSet_stream(PGconn *db, int fetchSize) __attribute__ ((visibility("hidden")));
+bool PostgresqlResultSet_isBinary(Oid type) __attribute__ ((visibility("hidden")));
+PreparedStatementDelegate_T PostgresqlPreparedStatement_new(Connection_T delegator, PGconn *db, int *queued, char *stmt, int parameterCount) __attribute__ ((visibility("hidden")));
+BulkLoaderDelegate_T PostgresqlBulkLoader_new(Connection_T delegator, PGconn *db) __attribute__ ((visibility("hidden")));
+#ifdef LIBPQ_HAS_PIPELINING
+PGresult *PostgresqlConnection_syncPipeline(PGconn *db, int *queued) __attribute__ ((visibility("hidden")));
+bool PostgresqlConnection_queued(PGconn *db, int *queued, PGresult **res) __attribute__ ((visibility("hidden")));
+#endif
 
 #endif
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) Tildeslash Ltd. All rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.
+ */
+
+
+#include "Config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "system/Time.h"
+#include "PostgresqlAdapter.h"
+
+
+/**
+ * Implementation of the BulkLoader/Delegate interface for postgresql. Rows
+ * are streamed with COPY FROM STDIN in text format, which lets the server
+ * convert each value to the column's type as for a text parameter.
+ *
+ * @file
+ */
+
+
+/* ----------------------------------------------------------- Definitions */
+
+
+#define T BulkLoaderDelegate_T
+struct T {
+        bool copying;
+        PGconn *db;
+        char *buffer;
+        int length;
+        int capacity;
+        Connection_T delegator;
+};
+
+
+/* ------------------------------------------------------- Private methods */
+
+
+/* Returns a pointer to room for at least n more bytes at the end of the buffer */
+static char *_reserve(T L, int n) {
+        if (L->length + n > L->capacity) {
+                L->capacity = (L->length + n) * 2;
+                if (L->buffer)
+                        RESIZE(L->buffer, L->capacity);
+                else
+                        L->buffer = ALLOC(L->capacity);
+        }
+        return L->buffer + L->length;
+}
+
+
+static inline void _put(T L, char c) {
+        *_reserve(L, 1) = c;
+        L->length++;
+}
+
+
+/* Escape backslash and the delimiter and line characters of COPY's text format */
+static char *_escape(char *p, const char *s, int size) {
+        for (int i = 0; i < size; i++) {
+                switch (s[i]) {
+                        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+                        case '\t': *p++ = '\\'; *p++ = 't'; break;
+                        case '\n': *p++ = '\\'; *p++ = 'n'; break;
+                        case '\r': *p++ = '\\'; *p++ = 'r'; break;
+                        default: *p++ = s[i]; break;
+                }
+        }
+        return p;
+}
+
+
+static void _encode(T L, BatchValue_T v) {
+        static const char hex[] = "0123456789abcdef";
+        char *p;
+        switch (v->type) {
+                case Batch_string:
+                        p = _escape(_reserve(L, 2 * v->size), v->v.p, v->size);
+                        break;
+                case Batch_int:
+                        p = _reserve(L, 24);
+                        p += snprintf(p, 24, "%lld", v->v.i);
+                        break;
+                case Batch_uint:
+                        p = _reserve(L, 24);
+                        p += snprintf(p, 24, "%llu", v->v.u);
+                        break;
+                case Batch_double:
+                        p = _reserve(L, 32);
+                        p += snprintf(p, 32, "%.17g", v->v.d);
+                        break;
+                case Batch_timestamp:
+                        p = _reserve(L, 20);
+                        p += strlen(Time_toString(v->v.t, p));
+                        break;
+                case Batch_blob:
+                        // bytea in hex format, with the backslash escaped for COPY
+                        p = _reserve(L, 3 + 2 * v->size);
+                        *p++ = '\\'; *p++ = '\\'; *p++ = 'x';
+                        for (int i = 0; i < v->size; i++) {
+                                unsigned char c = ((unsigned char *)v->v.p)[i];
+                                *p++ = hex[c >> 4];
+                                *p++ = hex[c & 0xf];
+                        }
+                        break;
+                default:
+                        p = _reserve(L, 2);
+                        *p++ = '\\'; *p++ = 'N';
+                        break;
+        }
+        L->length = (int)(p - L->buffer);
+}
+
+
+/* Read the result of the COPY and throw its error, if any */
+static void _copyResult(T L) {
+        PGresult *res;
+        char error[STRLEN] = {0};
+        while ((res = PQgetResult(L->db))) {
+                if (PQresultStatus(res) != PGRES_COMMAND_OK && ! *error)
+                        snprintf(error, STRLEN, "%s", PQresultErrorMessage(res));
+                PQclear(res);
+        }
+        if (*error)
+                THROW(SQLException, "%s", error);
+}
+
+
+/* ------------------------------------------------------------- Constructor */
+
+
+T PostgresqlBulkLoader_new(Connection_T delegator, PGconn *db) {
+        T L;
+        assert(db);
+        NEW(L);
+        L->delegator = delegator;
+        L->db = db;
+        L->copying = true;
+        return L;
+}
+
+
+/* -------------------------------------------------------- Delegate Methods */
+
+
+static void _free(T *L) {
+        assert(L && *L);
+        if ((*L)->copying) {
+                // Abort the COPY, which fails with this message
+                (*L)->copying = false;
+                if (PQputCopyEnd((*L)->db, "Bulk load aborted") == 1) {
+                        TRY
+                                _copyResult(*L);
+                        ELSE
+                        END_TRY;
+                }
+        }
+        FREE((*L)->buffer);
+        FREE(*L);
+}
+
+
+static void _load(T L, Batch_T rows) {
+        assert(L);
+        for (int row = 0; row < rows->rows; row++) {
+                for (int i = 0; i < rows->columns; i++) {
+                        if (i)
+                                _put(L, '\t');
+                        _encode(L, batchValue(rows, row, i));
+                }
+                _put(L, '\n');
+        }
+        int sent = PQputCopyData(L->db, L->buffer, L->length);
+        L->length = 0;
+        if (sent != 1)
+                THROW(SQLException, "%s", PQerrorMessage(L->db));
+}
+
+
+static void _finish(T L) {
+        assert(L);
+        L->copying = false;
+        if (PQputCopyEnd(L->db, NULL) != 1)
+                THROW(SQLException, "%s", PQerrorMessage(L->db));
+        _copyResult(L);
+}
+
+
+/* ------------------------------------------------------------------------- */
+
+
+const struct Lop_T postgresqllops = {
+        .name   = "postgresql",
+        .free   = _free,
+        .load   = _load,
+        .finish = _finish
+};
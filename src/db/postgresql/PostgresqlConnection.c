@@ -55,10 +55,12 @@ struct T {
         StringBuffer_T sb;
         Connection_T delegator;
 	ExecStatusType lastError;
+        int queued; // Statements sent in pipeline mode since the last sync
 };
 static _Atomic(uint32_t) kStatementID = 0;
 extern const struct Rop_T postgresqlrops;
 extern const struct Pop_T postgresqlpops;
+extern const struct Lop_T postgresqllops;
 
 
 /* ------------------------------------------------------- Private methods */
@@ -86,11 +88,11 @@ static bool _doConnect(T C, char **error) {
                 if (URL_getParameter(url, "unix-socket")[0] != '/')
                         ERROR("invalid unix-socket directory");
                 StringBuffer_append(C->sb, "host='%s' ", URL_getParameter(url, "unix-socket"));
-        } else if (URL_getHost(url)) {
-                StringBuffer_append(C->sb, "host='%s' ", URL_getHost(url));
+        } else if (Connection_getHost(C->delegator)) {
+                StringBuffer_append(C->sb, "host='%s' ", Connection_getHost(C->delegator));
                 /* Port */
-                if (URL_getPort(url) > 0)
-                        StringBuffer_append(C->sb, "port=%d ", URL_getPort(url));
+                if (Connection_getPort(C->delegator) > 0)
+                        StringBuffer_append(C->sb, "port=%d ", Connection_getPort(C->delegator));
                 else
                         ERROR("no port specified in URL");
         } else
@@ -112,6 +114,14 @@ static bool _doConnect(T C, char **error) {
                 StringBuffer_append(C->sb, "connect_timeout=%d ", SQL_DEFAULT_TIMEOUT/MSEC_PER_SEC);
         if (URL_getParameter(url, "application-name"))
                 StringBuffer_append(C->sb, "application_name='%s' ", URL_getParameter(url, "application-name"));
+        /* Set Connection ResultSet fetch size if found in URL, rows are then streamed */
+        const char *fetchSize = URL_getParameter(url, "fetch-size");
+        if (fetchSize) {
+                int rows = Str_parseInt(fetchSize);
+                if (rows < 1)
+                        ERROR("invalid fetch-size");
+                Connection_setFetchSize(C->delegator, rows);
+        }
         /* Connect */
         C->db = PQconnectdb(StringBuffer_toString(C->sb));
         if (PQstatus(C->db) == CONNECTION_OK)
@@ -122,6 +132,25 @@ error:
 }
 
 
+/* Execute sql, or in pipeline mode queue it */
+static bool _exec(T C, const char *sql) {
+        PQclear(C->res);
+        C->res = NULL;
+        if (PIPELINED(C->db)) {
+                // Only the extended query protocol may be used in a pipeline
+                C->lastError = PQsendQueryParams(C->db, sql, 0, NULL, NULL, NULL, NULL, 0) ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+#ifdef LIBPQ_HAS_PIPELINING
+                if (C->lastError == PGRES_COMMAND_OK && ! PostgresqlConnection_queued(C->db, &C->queued, &C->res))
+                        C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+#endif
+        } else {
+                C->res = PQexec(C->db, sql);
+                C->lastError = PQresultStatus(C->res);
+        }
+        return (C->lastError == PGRES_COMMAND_OK);
+}
+
+
 /* -------------------------------------------------------- Delegate Methods */
 
 
@@ -158,34 +187,25 @@ static bool _ping(T C) {
 static void _setQueryTimeout(T C, int ms) {
         assert(C);
         StringBuffer_set(C->sb, "SET statement_timeout TO %d;", ms);
-        PQclear(PQexec(C->db, StringBuffer_toString(C->sb)));
+        _exec(C, StringBuffer_toString(C->sb));
 }
 
 
 static bool _beginTransaction(T C) {
 	assert(C);
-        PGresult *res = PQexec(C->db, "BEGIN TRANSACTION;");
-        C->lastError = PQresultStatus(res);
-        PQclear(res);
-        return (C->lastError == PGRES_COMMAND_OK);
+        return _exec(C, "BEGIN TRANSACTION;");
 }
 
 
 static bool _commit(T C) {
 	assert(C);
-        PGresult *res = PQexec(C->db, "COMMIT TRANSACTION;");
-        C->lastError = PQresultStatus(res);
-        PQclear(res);
-        return (C->lastError == PGRES_COMMAND_OK);
+        return _exec(C, "COMMIT TRANSACTION;");
 }
 
 
 static bool _rollback(T C) {
 	assert(C);
-        PGresult *res = PQexec(C->db, "ROLLBACK TRANSACTION;");
-        C->lastError = PQresultStatus(res);
-        PQclear(res);
-        return (C->lastError == PGRES_COMMAND_OK);
+        return _exec(C, "ROLLBACK TRANSACTION;");
 }
 
 
@@ -197,21 +217,19 @@ static long long _lastRowId(T C) {
 
 static long long _rowsChanged(T C) {
         assert(C);
-        char *changes = PQcmdTuples(C->res);
-        return changes ? Str_parseLLong(changes) : 0;
+        // A statement queued in a pipeline has no result yet
+        char *changes = C->res ? PQcmdTuples(C->res) : NULL;
+        return STR_DEF(changes) ? Str_parseLLong(changes) : 0;
 }
 
 
 static bool _execute(T C, const char *sql, va_list ap) {
 	assert(C);
-        PQclear(C->res);
         va_list ap_copy;
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
-        C->lastError = PQresultStatus(C->res);
-        return (C->lastError == PGRES_COMMAND_OK);
+        return _exec(C, StringBuffer_toString(C->sb));
 }
 
 
@@ -222,10 +240,28 @@ static ResultSet_T _executeQuery(T C, const char *sql, va_list ap) {
         va_copy(ap_copy, ap);
         StringBuffer_vset(C->sb, sql, ap_copy);
         va_end(ap_copy);
-        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
-        C->lastError = PQresultStatus(C->res);
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PIPELINED(C->db)) {
+                // Send the query and read its result after the results of statements queued before it
+                C->res = PQsendQueryParams(C->db, StringBuffer_toString(C->sb), 0, NULL, NULL, NULL, NULL, 0) ? PostgresqlConnection_syncPipeline(C->db, &C->queued) : NULL;
+                C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        } else
+#endif
+        if (STREAMING(C->delegator, C->db)) {
+                C->res = PQsendQuery(C->db, StringBuffer_toString(C->sb)) ? PostgresqlResultSet_stream(C->db, Connection_getFetchSize(C->delegator)) : NULL;
+                C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        } else {
+                C->res = PQexec(C->db, StringBuffer_toString(C->sb));
+                C->lastError = PQresultStatus(C->res);
+        }
         if (C->lastError == PGRES_TUPLES_OK)
-                return ResultSet_new(PostgresqlResultSet_new(C->delegator, C->res), (Rop_T)&postgresqlrops);
+                return ResultSet_new(PostgresqlResultSet_new(C->delegator, C->db, C->res), (Rop_T)&postgresqlrops);
+        if (PARTIAL(C->lastError)) {
+                // Streaming, the ResultSet owns the result
+                PGresult *res = C->res;
+                C->res = NULL;
+                return ResultSet_new(PostgresqlResultSet_new(C->delegator, C->db, res), (Rop_T)&postgresqlrops);
+        }
         return NULL;
 }
 
@@ -241,21 +277,187 @@ static PreparedStatement_T _prepareStatement(T C, const char *sql, va_list ap) {
         int paramCount = StringBuffer_prepare4postgres(C->sb);
         uint32_t t = kStatementID++; // increment is atomic
         char *name = Str_cat("__libzdb-%d", t);
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PIPELINED(C->db))
+                C->res = PQsendPrepare(C->db, name, StringBuffer_toString(C->sb), 0, NULL) ? PostgresqlConnection_syncPipeline(C->db, &C->queued) : NULL;
+        else
+#endif
         C->res = PQprepare(C->db, name, StringBuffer_toString(C->sb), 0, NULL);
         C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
         if (C->lastError == PGRES_EMPTY_QUERY || C->lastError == PGRES_COMMAND_OK || C->lastError == PGRES_TUPLES_OK)
-		return PreparedStatement_new(PostgresqlPreparedStatement_new(C->delegator, C->db, name, paramCount), (Pop_T)&postgresqlpops);
+		return PreparedStatement_new(PostgresqlPreparedStatement_new(C->delegator, C->db, &C->queued, name, paramCount), (Pop_T)&postgresqlpops);
         FREE(name);
         return NULL;
 }
 
 
+static BulkLoader_T _bulkLoad(T C, const char *table, const char *columns, int columnCount) {
+        assert(C);
+        PQclear(C->res);
+        StringBuffer_set(C->sb, "COPY %s (%s) FROM STDIN;", table, columns);
+        C->res = PQexec(C->db, StringBuffer_toString(C->sb));
+        C->lastError = PQresultStatus(C->res);
+        if (C->lastError == PGRES_COPY_IN)
+                return BulkLoader_new(PostgresqlBulkLoader_new(C->delegator, C->db), (Lop_T)&postgresqllops, columnCount);
+        return NULL;
+}
+
+
 static const char *_getLastError(T C) {
 	assert(C);
-        return C->res ? PQresultErrorMessage(C->res) : "unknown error";
+        return C->res ? PQresultErrorMessage(C->res) : PQerrorMessage(C->db);
+}
+
+
+/* Returns the single value of a one row query or NULL on error. The value is
+ owned by C->res */
+static const char *_getValue(T C, const char *sql, const char *param) {
+        PQclear(C->res);
+        C->res = PQexecParams(C->db, sql, param ? 1 : 0, NULL, param ? &param : NULL, NULL, NULL, 0);
+        C->lastError = PQresultStatus(C->res);
+        if (C->lastError == PGRES_TUPLES_OK && PQntuples(C->res) == 1 && ! PQgetisnull(C->res, 0, 0))
+                return PQgetvalue(C->res, 0, 0);
+        return NULL;
+}
+
+
+static long long _replicationLag(T C) {
+        assert(C);
+        // A replica which has replayed all WAL it received is not behind, even if the primary is idle
+        const char *lag = _getValue(C, "SELECT CASE WHEN NOT pg_is_in_recovery() THEN 0 "
+                                       "WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+                                       "ELSE COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000, -1) END::bigint", NULL);
+        return lag ? Str_parseLLong(lag) : -1;
+}
+
+
+static char *_replicationPosition(T C) {
+        assert(C);
+        const char *lsn = _getValue(C, "SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() "
+                                       "ELSE pg_current_wal_lsn() END::text", NULL);
+        return lsn ? Str_dup(lsn) : NULL;
+}
+
+
+static bool _hasReplayed(T C, const char *position) {
+        assert(C);
+        const char *replayed = _getValue(C, "SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() >= $1::pg_lsn "
+                                            "ELSE true END", position);
+        return replayed && *replayed == 't';
+}
+
+
+static bool _reset(T C) {
+        assert(C);
+        return _exec(C, "DISCARD ALL;");
+}
+
+
+static long long _sessionId(T C) {
+        assert(C);
+        return PQbackendPID(C->db);
+}
+
+
+static int _maxParameters(T C) {
+        assert(C);
+        return 65535; // The Bind message's parameter count is a 16 bit integer
+}
+
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+static bool _beginPipeline(T C) {
+        assert(C);
+        PQclear(C->res);
+        C->res = NULL;
+        C->queued = 0;
+        C->lastError = PQenterPipelineMode(C->db) ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+        return (C->lastError == PGRES_COMMAND_OK);
+}
+
+
+static bool _endPipeline(T C) {
+        assert(C);
+        PQclear(C->res);
+        C->res = PostgresqlConnection_syncPipeline(C->db, &C->queued);
+        C->lastError = C->res ? PQresultStatus(C->res) : PGRES_FATAL_ERROR;
+        if (! PQexitPipelineMode(C->db) && C->res) {
+                PQclear(C->res);
+                C->res = NULL;
+                C->lastError = PGRES_FATAL_ERROR;
+        }
+        return (C->lastError == PGRES_COMMAND_OK || C->lastError == PGRES_TUPLES_OK);
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+/**
+ * Send a pipeline sync and read the results of all statements queued before
+ * it, in order. Statements after a failed statement are aborted by the server.
+ * Returns the first failed result or else the last result, or NULL if the
+ * connection failed. The caller must clear the result
+ */
+PGresult *PostgresqlConnection_syncPipeline(PGconn *db, int *queued) {
+        PGresult *res, *last = NULL;
+        bool failed = false, synced = false;
+        *queued = 0;
+        if (! PQpipelineSync(db))
+                return NULL;
+        // Each statement's results are terminated by a NULL result, two in a row means no more results
+        for (int nulls = 0; nulls < 2 && ! synced; ) {
+                if (! (res = PQgetResult(db))) {
+                        nulls++;
+                        continue;
+                }
+                nulls = 0;
+                ExecStatusType status = PQresultStatus(res);
+                if (status == PGRES_PIPELINE_SYNC) {
+                        synced = true;
+                        PQclear(res);
+                } else if (failed || status == PGRES_PIPELINE_ABORTED) {
+                        PQclear(res);
+                } else {
+                        PQclear(last);
+                        last = res;
+                        failed = ! (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK || status == PGRES_EMPTY_QUERY);
+                }
+        }
+        if (! synced && ! failed) {
+                PQclear(last);
+                return NULL;
+        }
+        return last ? last : PQmakeEmptyPGresult(db, PGRES_COMMAND_OK);
 }
 
 
+/**
+ * Count a statement sent in pipeline mode. The socket is blocking, so every
+ * SQL_PIPELINE_DEPTH statements the pipeline is synchronized before the 
+ * server's output fills and neither side can write. Returns false if a 
+ * statement failed, with its result, or NULL if the connection failed, in
+ * res. Otherwise res is cleared
+ */
+bool PostgresqlConnection_queued(PGconn *db, int *queued, PGresult **res) {
+        PQclear(*res);
+        *res = NULL;
+        if (++*queued < SQL_PIPELINE_DEPTH)
+                return true;
+        *res = PostgresqlConnection_syncPipeline(db, queued);
+        ExecStatusType status = *res ? PQresultStatus(*res) : PGRES_FATAL_ERROR;
+        if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK || status == PGRES_EMPTY_QUERY) {
+                PQclear(*res);
+                *res = NULL;
+                return true;
+        }
+        return false;
+}
+
+#endif
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -273,6 +475,17 @@ const struct Cop_T postgresqlcops = {
         .execute          = _execute,
         .executeQuery     = _executeQuery,
         .prepareStatement = _prepareStatement,
-        .getLastError     = _getLastError
+        .bulkLoad         = _bulkLoad,
+        .getLastError     = _getLastError,
+        .replicationLag   = _replicationLag,
+        .replicationPosition = _replicationPosition,
+        .hasReplayed      = _hasReplayed,
+        .reset            = _reset,
+        .sessionId        = _sessionId,
+        .maxParameters    = _maxParameters,
+#ifdef LIBPQ_HAS_PIPELINING
+        .beginPipeline    = _beginPipeline,
+        .endPipeline      = _endPipeline
+#endif
 };
 
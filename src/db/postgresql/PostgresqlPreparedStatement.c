@@ -34,8 +34,23 @@
 
 /**
  * Implementation of the PreparedStatement/Delegate interface for postgresql.
- * All parameter values are sent as text except for blobs. Postgres ignore
- * paramLengths for text parameters and it is therefor set to 0, except for blob.
+ *
+ * Parameter values are kept as set and encoded when the statement is
+ * executed. The statement is described the second time it is executed, so 
+ * a statement executed once costs no extra round-trip, and from then on 
+ * integers, floats and timestamps are sent in binary format for parameters
+ * the server inferred to be of type int2, int4, int8, float4, float8, 
+ * timestamp or timestamptz. Other values, values out of range of the 
+ * parameter type and values of a statement not yet described are sent as
+ * text and converted by the server. Blobs are always sent in binary format.
+ * Postgres ignores paramLengths for text parameters and it is therefore set
+ * to 0.
+ *
+ * With the URL parameter <code>binary-result=true</code> query results are
+ * requested in binary format if all columns are of a type the ResultSet can
+ * decode, which is found by describing the statement. As for parameters, 
+ * this is done at the second execution, so the first query and a statement
+ * executed once have results in text format.
  *
  * @file
  */
@@ -52,9 +67,16 @@ struct T {
         int lastError;
         char *stmt;
         PGconn *db;
+        int *queued; // The Connection's count of statements sent in pipeline mode
         PGresult *res;
         param_t params;
         int parameterCount;
+        int executions;
+        bool described;
+        bool discarded; // Deallocated by a session reset
+        int resultFormat; // -1 until the statement is described
+        Oid *paramTypes; // As inferred by the server, 0 until described
+        struct BatchValue_T *values; // As set, strings and blobs by reference
         char **paramValues; 
         int *paramLengths; 
         int *paramFormats;
@@ -63,24 +85,190 @@ struct T {
 extern const struct Rop_T postgresqlrops;
 
 
+/* ------------------------------------------------------- Private methods */
+
+
+static inline void _put32(uchar_t *b, uint32_t x) {
+        b[0] = (uchar_t)(x >> 24);
+        b[1] = (uchar_t)(x >> 16);
+        b[2] = (uchar_t)(x >> 8);
+        b[3] = (uchar_t)x;
+}
+
+
+static inline void _put64(uchar_t *b, uint64_t x) {
+        _put32(b, (uint32_t)(x >> 32));
+        _put32(b + 4, (uint32_t)x);
+}
+
+
+/* Describe the statement for the types of its parameters and, if binary
+ results are wanted, of its result columns */
+static void _describe(T P) {
+        if (P->described || PIPELINED(P->db))
+                return;
+        PGresult *res = PQdescribePrepared(P->db, P->stmt);
+        if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+                P->described = true;
+                for (int i = 0; i < P->parameterCount && i < PQnparams(res); i++)
+                        P->paramTypes[i] = PQparamtype(res, i);
+                if (P->resultFormat < 0) {
+                        P->resultFormat = PQnfields(res) > 0;
+                        for (int i = 0; i < PQnfields(res) && P->resultFormat; i++)
+                                P->resultFormat = PostgresqlResultSet_isBinary(PQftype(res, i));
+                }
+        }
+        PQclear(res);
+}
+
+
+static bool _bindDouble(T P, int i, double x) {
+        uchar_t *b = (uchar_t *)P->params[i].s;
+        switch (P->paramTypes[i]) {
+                case FLOAT4OID:
+                {
+                        union { float f; uint32_t i; } u = {.f = (float)x};
+                        _put32(b, u.i);
+                        P->paramLengths[i] = 4;
+                        break;
+                }
+                case FLOAT8OID:
+                {
+                        union { double d; uint64_t i; } u = {.d = x};
+                        _put64(b, u.i);
+                        P->paramLengths[i] = 8;
+                        break;
+                }
+                default:
+                        return false;
+        }
+        P->paramValues[i] = P->params[i].s;
+        P->paramFormats[i] = 1;
+        return true;
+}
+
+
+static bool _bindInteger(T P, int i, long long x) {
+        uchar_t *b = (uchar_t *)P->params[i].s;
+        switch (P->paramTypes[i]) {
+                case INT2OID:
+                        if (x < INT16_MIN || x > INT16_MAX)
+                                return false;
+                        b[0] = (uchar_t)(x >> 8);
+                        b[1] = (uchar_t)x;
+                        P->paramLengths[i] = 2;
+                        break;
+                case INT4OID:
+                        if (x < INT32_MIN || x > INT32_MAX)
+                                return false;
+                        _put32(b, (uint32_t)x);
+                        P->paramLengths[i] = 4;
+                        break;
+                case INT8OID:
+                        _put64(b, (uint64_t)x);
+                        P->paramLengths[i] = 8;
+                        break;
+                default:
+                        return _bindDouble(P, i, (double)x);
+        }
+        P->paramValues[i] = P->params[i].s;
+        P->paramFormats[i] = 1;
+        return true;
+}
+
+
+static bool _bindTimestamp(T P, int i, time_t x) {
+        if (P->paramTypes[i] != TIMESTAMPOID && P->paramTypes[i] != TIMESTAMPTZOID)
+                return false;
+        _put64((uchar_t *)P->params[i].s, (uint64_t)(((long long)x - POSTGRES_EPOCH) * USEC_PER_SEC));
+        P->paramValues[i] = P->params[i].s;
+        P->paramLengths[i] = 8;
+        P->paramFormats[i] = 1;
+        return true;
+}
+
+
+/* Encode the value of parameter i, in binary format if the parameter type
+ is known and the value is in its range, otherwise as text. The text of a
+ double has all its digits and the text of a timestamp an explicit UTC
+ offset, so the server reads the same value in either format */
+static void _bindValue(T P, int i, BatchValue_T v) {
+        P->paramValues[i] = P->params[i].s;
+        P->paramLengths[i] = 0;
+        P->paramFormats[i] = 0;
+        switch (v->type) {
+                case Batch_string:
+                        P->paramValues[i] = (char *)v->v.p;
+                        break;
+                case Batch_int:
+                        if (! _bindInteger(P, i, v->v.i))
+                                snprintf(P->params[i].s, 64, "%lld", v->v.i);
+                        break;
+                case Batch_uint:
+                        if (! (v->v.u <= INT64_MAX && _bindInteger(P, i, (long long)v->v.u)))
+                                snprintf(P->params[i].s, 64, "%llu", v->v.u);
+                        break;
+                case Batch_double:
+                        if (! _bindDouble(P, i, v->v.d))
+                                snprintf(P->params[i].s, 64, "%.17g", v->v.d);
+                        break;
+                case Batch_timestamp:
+                        if (! _bindTimestamp(P, i, v->v.t))
+                                strcat(Time_toString(v->v.t, P->params[i].s), "+00");
+                        break;
+                case Batch_blob:
+                        P->paramValues[i] = (char *)v->v.p;
+                        P->paramLengths[i] = v->v.p ? v->size : 0;
+                        P->paramFormats[i] = 1;
+                        break;
+                default:
+                        P->paramValues[i] = NULL;
+                        break;
+        }
+}
+
+
+/* Encode the parameter values set. The statement is described at its 
+ second execution if it has parameters or is a query wanting binary results */
+static void _bind(T P, bool isQuery) {
+        if (! P->described && P->executions && (P->parameterCount || (isQuery && P->resultFormat < 0)))
+                _describe(P);
+        P->executions++;
+        for (int i = 0; i < P->parameterCount; i++)
+                _bindValue(P, i, &P->values[i]);
+}
+
+
+static void _setInteger(T P, int parameterIndex, long long x) {
+        assert(P);
+        int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
+        P->values[i].type = Batch_int;
+        P->values[i].v.i = x;
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
-T PostgresqlPreparedStatement_new(Connection_T delegator, PGconn *db, char *stmt, int parameterCount) {
+T PostgresqlPreparedStatement_new(Connection_T delegator, PGconn *db, int *queued, char *stmt, int parameterCount) {
         T P;
         assert(db);
         assert(stmt);
         NEW(P);
         P->delegator = delegator;
         P->db = db;
+        P->queued = queued;
         P->stmt = stmt;
         P->parameterCount = parameterCount;
         P->lastError = PGRES_COMMAND_OK;
+        P->resultFormat = IS(URL_getParameter(Connection_getURL(delegator), "binary-result"), "true") ? -1 : 0;
         if (P->parameterCount) {
                 P->paramValues = CALLOC(P->parameterCount, sizeof(char *));
                 P->paramLengths = CALLOC(P->parameterCount, sizeof(int));
                 P->paramFormats = CALLOC(P->parameterCount, sizeof(int));
                 P->params = CALLOC(P->parameterCount, sizeof(struct param_t));
+                P->paramTypes = CALLOC(P->parameterCount, sizeof(Oid));
+                P->values = CALLOC(P->parameterCount, sizeof(struct BatchValue_T));
         }
         return P;
 }
@@ -95,9 +283,18 @@ static void _free(T *P) {
          deallocation as of postgres v. 11 - the DEALLOCATE statement
          has to be used. The postgres documentation mentiones such a
          function as a possible future extension */
-        char stmt[STRLEN];
-        snprintf(stmt, STRLEN, "DEALLOCATE \"%s\";", (*P)->stmt);
-        PQclear(PQexec((*P)->db, stmt));
+        if (! (*P)->discarded) {
+                char stmt[STRLEN];
+                snprintf(stmt, STRLEN, "DEALLOCATE \"%s\";", (*P)->stmt);
+#ifdef LIBPQ_HAS_PIPELINING
+                if (PIPELINED((*P)->db)) {
+                        // Errors are ignored, as when the statement is deallocated outside a pipeline
+                        if (PQsendQueryParams((*P)->db, stmt, 0, NULL, NULL, NULL, NULL, 0))
+                                PostgresqlConnection_queued((*P)->db, (*P)->queued, &(*P)->res);
+                } else
+#endif
+                        PQclear(PQexec((*P)->db, stmt));
+        }
         PQclear((*P)->res);
 	FREE((*P)->stmt);
         if ((*P)->parameterCount) {
@@ -105,6 +302,8 @@ static void _free(T *P) {
 	        FREE((*P)->paramLengths);
 	        FREE((*P)->paramFormats);
 	        FREE((*P)->params);
+	        FREE((*P)->paramTypes);
+	        FREE((*P)->values);
         }
 	FREE(*P);
 }
@@ -113,63 +312,97 @@ static void _free(T *P) {
 static void _setString(T P, int parameterIndex, const char *x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->paramValues[i] = (char *)x;
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        P->values[i].type = x ? Batch_string : Batch_null;
+        P->values[i].v.p = (char *)x;
 }
 
 
-static void _setInt(T P, int parameterIndex, int x) {
-        assert(P);
-        int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        snprintf(P->params[i].s, 64, "%d", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+static void _setInt8(T P, int parameterIndex, int8_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt8(T P, int parameterIndex, uint8_t x) {
+        _setInteger(P, parameterIndex, x);
 }
 
 
-static void _setLLong(T P, int parameterIndex, long long x) {
+static void _setInt16(T P, int parameterIndex, int16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt16(T P, int parameterIndex, uint16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt32(T P, int parameterIndex, int32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt32(T P, int parameterIndex, uint32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt64(T P, int parameterIndex, int64_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt64(T P, int parameterIndex, uint64_t x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        snprintf(P->params[i].s, 64, "%lld", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0; 
-        P->paramFormats[i] = 0;
+        P->values[i].type = Batch_uint;
+        P->values[i].v.u = x;
 }
 
 
 static void _setDouble(T P, int parameterIndex, double x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        snprintf(P->params[i].s, 64, "%lf", x);
-        P->paramValues[i] =  P->params[i].s;
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        P->values[i].type = Batch_double;
+        P->values[i].v.d = x;
 }
 
 
 static void _setTimestamp(T P, int parameterIndex, time_t x) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->paramValues[i] = Time_toString(x, P->params[i].s);
-        P->paramLengths[i] = 0;
-        P->paramFormats[i] = 0;
+        P->values[i].type = Batch_timestamp;
+        P->values[i].v.t = x;
 }
 
 
 static void _setBlob(T P, int parameterIndex, const void *x, int size) {
         assert(P);
         int i = checkAndSetParameterIndex(parameterIndex, P->parameterCount);
-        P->paramValues[i] = (char *)x;
-        P->paramLengths[i] = (x) ? size : 0;
-        P->paramFormats[i] = 1;
+        P->values[i].type = Batch_blob;
+        P->values[i].v.p = (void *)x;
+        P->values[i].size = size;
 }
 
 
 static void _execute(T P) {
         assert(P);
         PQclear(P->res);
+        _bind(P, false);
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PIPELINED(P->db)) {
+                // Queued, the result is read when the pipeline is synchronized
+                P->res = NULL;
+                P->lastError = PQsendQueryPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0) ? PGRES_COMMAND_OK : PGRES_FATAL_ERROR;
+                if (P->lastError != PGRES_COMMAND_OK)
+                        THROW(SQLException, "%s", PQerrorMessage(P->db));
+                if (! PostgresqlConnection_queued(P->db, P->queued, &P->res)) {
+                        P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
+                        THROW(SQLException, "%s", P->res ? PQresultErrorMessage(P->res) : PQerrorMessage(P->db));
+                }
+                return;
+        }
+#endif
         P->res = PQexecPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0);
         P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
         if (P->lastError != PGRES_COMMAND_OK)
@@ -177,22 +410,181 @@ static void _execute(T P) {
 }
 
 
+#ifdef LIBPQ_HAS_PIPELINING
+
+/* Read the result of the next statement sent in pipeline mode. Rows changed
+ are stored in changes, unless NULL, and the first error is copied to error.
+ Returns false if there are no more results before the pipeline sync */
+static bool _pipelineResult(T P, long long *changes, char error[STRLEN]) {
+        PGresult *res = PQgetResult(P->db);
+        if (! res)
+                return false;
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK) {
+                if (changes) {
+                        char *tuples = PQcmdTuples(res);
+                        *changes = STR_DEF(tuples) ? Str_parseLLong(tuples) : 0;
+                }
+        } else if (! *error) {
+                P->lastError = status;
+                snprintf(error, STRLEN, "%s", status == PGRES_PIPELINE_ABORTED ? "Pipeline aborted" : PQresultErrorMessage(res));
+        }
+        PQclear(res);
+        // Each statement's results are terminated by a NULL result
+        PQclear(PQgetResult(P->db));
+        return true;
+}
+
+
+/* Read and discard the remaining results up to and including the pipeline sync */
+static void _pipelineSynced(T P) {
+        // Two NULL results in a row means no more results
+        for (int nulls = 0; nulls < 2; ) {
+                PGresult *res = PQgetResult(P->db);
+                if (! res) {
+                        nulls++;
+                        continue;
+                }
+                nulls = 0;
+                ExecStatusType status = PQresultStatus(res);
+                PQclear(res);
+                if (status == PGRES_PIPELINE_SYNC)
+                        break;
+        }
+}
+
+
+static bool _sendRow(T P, Batch_T batch, int row) {
+        for (int i = 0; i < batch->columns; i++)
+                _bindValue(P, i, batchValue(batch, row, i));
+        return PQsendQueryPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0);
+}
+
+
+static inline bool _sendCommand(T P, const char *sql) {
+        return PQsendQueryParams(P->db, sql, 0, NULL, NULL, NULL, NULL, 0);
+}
+
+
+/* Send the batch in pipeline mode so the statements, up to SQL_PIPELINE_DEPTH
+ at a time, are executed in one round-trip. The statements between two 
+ pipeline syncs form an implicit transaction of their own, so in auto-commit
+ mode the batch is executed in an explicit transaction to be all or nothing */
+static void _executeBatch(T P, Batch_T batch) {
+        assert(P);
+        char error[STRLEN] = {0};
+        if (PIPELINED(P->db)) {
+                // In the Connection's pipeline the batch is queued and rows changed are unknown
+                for (int row = 0; row < batch->rows; row++) {
+                        if (! _sendRow(P, batch, row))
+                                THROW(SQLException, "%s", PQerrorMessage(P->db));
+                        batch->rowsChanged[row] = -1;
+                        if (! PostgresqlConnection_queued(P->db, P->queued, &P->res))
+                                THROW(SQLException, "%s", P->res ? PQresultErrorMessage(P->res) : PQerrorMessage(P->db));
+                }
+                return;
+        }
+        // The statement is executed many times, send the values in binary format
+        _describe(P);
+        bool autocommit = PQtransactionStatus(P->db) == PQTRANS_IDLE;
+        if (! PQenterPipelineMode(P->db))
+                THROW(SQLException, "%s", PQerrorMessage(P->db));
+        P->lastError = PGRES_COMMAND_OK;
+        TRY
+        {
+                if (autocommit && ! _sendCommand(P, "BEGIN")) {
+                        P->lastError = PGRES_FATAL_ERROR;
+                        snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                }
+                for (int row = 0; row < batch->rows && ! *error; row += SQL_PIPELINE_DEPTH) {
+                        int sent = row;
+                        int end = row + SQL_PIPELINE_DEPTH < batch->rows ? row + SQL_PIPELINE_DEPTH : batch->rows;
+                        for (; sent < end; sent++) {
+                                if (! _sendRow(P, batch, sent)) {
+                                        P->lastError = PGRES_FATAL_ERROR;
+                                        snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                                        break;
+                                }
+                        }
+                        bool commit = autocommit && sent == batch->rows && ! *error;
+                        if (commit && ! (commit = _sendCommand(P, "COMMIT"))) {
+                                P->lastError = PGRES_FATAL_ERROR;
+                                snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                        }
+                        if (! PQpipelineSync(P->db) && ! *error) {
+                                P->lastError = PGRES_FATAL_ERROR;
+                                snprintf(error, STRLEN, "%s", PQerrorMessage(P->db));
+                        }
+                        if (autocommit && row == 0)
+                                _pipelineResult(P, NULL, error);
+                        for (int i = row; i < sent && _pipelineResult(P, &batch->rowsChanged[i], error); i++)
+                                ;
+                        if (commit)
+                                _pipelineResult(P, NULL, error);
+                        _pipelineSynced(P);
+                }
+        }
+        ELSE
+        {
+                // Read what was sent so the connection can leave pipeline mode
+                int queued = 0;
+                PQclear(PostgresqlConnection_syncPipeline(P->db, &queued));
+                P->lastError = PGRES_FATAL_ERROR;
+                snprintf(error, STRLEN, "%s", Exception_frame.message);
+        }
+        END_TRY;
+        if (*error) {
+                // The batch's transaction, or the caller's, is rolled back so no entry changed any rows
+                memset(batch->rowsChanged, 0, batch->rows * sizeof(long long));
+                if (autocommit) {
+                        int queued = 0;
+                        if (_sendCommand(P, "ROLLBACK"))
+                                PQclear(PostgresqlConnection_syncPipeline(P->db, &queued));
+                }
+        }
+        PQexitPipelineMode(P->db);
+        if (*error)
+                THROW(SQLException, "%s", error);
+}
+
+#endif
+
+
 static ResultSet_T _executeQuery(T P) {
         assert(P);
         PQclear(P->res);
-        P->res = PQexecPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, 0);
+        P->res = NULL;
+        _bind(P, true);
+        int resultFormat = P->resultFormat > 0;
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PIPELINED(P->db)) {
+                // Send the query and read its result after the results of statements queued before it
+                P->res = PQsendQueryPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, resultFormat) ? PostgresqlConnection_syncPipeline(P->db, P->queued) : NULL;
+        } else
+#endif
+        if (STREAMING(P->delegator, P->db))
+                P->res = PQsendQueryPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, resultFormat) ? PostgresqlResultSet_stream(P->db, Connection_getFetchSize(P->delegator)) : NULL;
+        else
+                P->res = PQexecPrepared(P->db, P->stmt, P->parameterCount, (const char **)P->paramValues, P->paramLengths, P->paramFormats, resultFormat);
         P->lastError = P->res ? PQresultStatus(P->res) : PGRES_FATAL_ERROR;
         if (P->lastError == PGRES_TUPLES_OK)
-                return ResultSet_new(PostgresqlResultSet_new(P->delegator, P->res), (Rop_T)&postgresqlrops);
-        THROW(SQLException, "%s", PQresultErrorMessage(P->res));
+                return ResultSet_new(PostgresqlResultSet_new(P->delegator, P->db, P->res), (Rop_T)&postgresqlrops);
+        if (PARTIAL(P->lastError)) {
+                // Streaming, the ResultSet owns the result
+                PGresult *res = P->res;
+                P->res = NULL;
+                return ResultSet_new(PostgresqlResultSet_new(P->delegator, P->db, res), (Rop_T)&postgresqlrops);
+        }
+        THROW(SQLException, "%s", P->res ? PQresultErrorMessage(P->res) : PQerrorMessage(P->db));
         return NULL;
 }
 
 
 static long long _rowsChanged(T P) {
         assert(P);
-        char *changes = PQcmdTuples(P->res);
-        return changes ? Str_parseLLong(changes) : 0;
+        // A statement queued in a pipeline has no result yet
+        char *changes = P->res ? PQcmdTuples(P->res) : NULL;
+        return STR_DEF(changes) ? Str_parseLLong(changes) : 0;
 }
 
 
@@ -202,6 +594,12 @@ static int _parameterCount(T P) {
 }
 
 
+static void _discard(T P) {
+        assert(P);
+        P->discarded = true;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -209,14 +607,24 @@ const struct Pop_T postgresqlpops = {
         .name           = "postgresql",
         .free           = _free,
         .setString      = _setString,
-        .setInt         = _setInt,
-        .setLLong       = _setLLong,
+        .setInt8        = _setInt8,
+        .setUInt8       = _setUInt8,
+        .setInt16       = _setInt16,
+        .setUInt16      = _setUInt16,
+        .setInt32       = _setInt32,
+        .setUInt32      = _setUInt32,
+        .setInt64       = _setInt64,
+        .setUInt64      = _setUInt64,
         .setDouble      = _setDouble,
         .setTimestamp   = _setTimestamp,
         .setBlob        = _setBlob,
         .execute        = _execute,
         .executeQuery   = _executeQuery,
         .rowsChanged    = _rowsChanged,
-        .parameterCount = _parameterCount
+        .parameterCount = _parameterCount,
+        .discard        = _discard,
+#ifdef LIBPQ_HAS_PIPELINING
+        .executeBatch   = _executeBatch
+#endif
 };
 
@@ -26,8 +26,10 @@
 #include "Config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 #include <sys/types.h>
 
 #include "PostgresqlAdapter.h"
@@ -37,6 +39,16 @@
  * Implementation of the ResultSet/Delegate interface for postgresql.
  * Accessing columns with index outside range throws SQLException
  *
+ * A ResultSet is either buffered, with all rows in one PGresult owned by
+ * the Connection or PreparedStatement, or streaming, where rows are read
+ * from the server in single row or chunked rows mode as the ResultSet
+ * advances. A streaming ResultSet owns its PGresult
+ *
+ * Results of prepared statements may be in binary format, see 
+ * PostgresqlPreparedStatement.c. Numbers and timestamps are then decoded 
+ * directly from network byte order and getString() formats values as the
+ * server would in text format, except timestamptz which is given in UTC
+ *
  * @file
  */
 
@@ -44,13 +56,21 @@
 /* ----------------------------------------------------------- Definitions */
 
 
+typedef struct column_t {
+        int size;
+        char *s; // Text of a binary value
+} *column_t;
 #define T ResultSetDelegate_T
 struct T {
         int maxRows;
         int rowCount;
         int currentRow;
         int columnCount;
+        int fetchSize;
+        long long rows; // Rows read so far
+        PGconn *db; // NULL unless streaming and rows remain on the server
         PGresult *res;
+        column_t columns; // NULL unless the result is in binary format
         Connection_T delegator;
 };
 #define ISFIRSTOCTDIGIT(CH) ((CH) >= '0' && (CH) <= '3')
@@ -114,10 +134,229 @@ static inline const void *_unescape_bytea(uchar_t *s, int len, int *r) {
         return s;
 }
 
+static inline uint16_t _get16(const uchar_t *p) {
+        return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+
+static inline uint32_t _get32(const uchar_t *p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+
+static inline uint64_t _get64(const uchar_t *p) {
+        return (uint64_t)_get32(p) << 32 | _get32(p + 4);
+}
+
+
+static inline double _getFloat8(const uchar_t *p) {
+        union { uint64_t i; double d; } u = {.i = _get64(p)};
+        return u.d;
+}
+
+
+static inline float _getFloat4(const uchar_t *p) {
+        union { uint32_t i; float f; } u = {.i = _get32(p)};
+        return u.f;
+}
+
+
+/* Returns a buffer for the text of column i of at least size bytes */
+static char *_buffer(T R, int i, int size) {
+        column_t c = &R->columns[i];
+        if (c->size < size) {
+                if (c->s)
+                        RESIZE(c->s, size);
+                else
+                        c->s = ALLOC(size);
+                c->size = size;
+        }
+        return c->s;
+}
+
+
+/* Format d with the fewest digits that read back as the same value, like
+ the server does. Fixed notation is used for exponents from -4 up to 
+ threshold, 15 for float8 and 6 for float4 */
+static char *_formatFloat(double d, bool isFloat4, char s[32]) {
+        if (isnan(d))
+                return strcpy(s, "NaN");
+        if (isinf(d))
+                return strcpy(s, d > 0 ? "Infinity" : "-Infinity");
+        if (d == 0)
+                return strcpy(s, signbit(d) ? "-0" : "0");
+        int p = 1;
+        for (; p < 17; p++) {
+                snprintf(s, 32, "%.*e", p - 1, d);
+                if (isFloat4 ? strtof(s, NULL) == (float)d : strtod(s, NULL) == d)
+                        break;
+        }
+        snprintf(s, 32, "%.*e", p - 1, d);
+        int exponent = atoi(strchr(s, 'e') + 1);
+        if (exponent >= -4 && exponent < (isFloat4 ? 6 : 15))
+                snprintf(s, 32, "%.*f", p - 1 - exponent > 0 ? p - 1 - exponent : 0, d);
+        return s;
+}
+
+
+/* Format a timestamp, microseconds since 2000-01-01, in the ISO style */
+static char *_formatTimestamp(int64_t t, bool hasZone, char s[64]) {
+        if (t == INT64_MAX)
+                return strcpy(s, "infinity");
+        if (t == INT64_MIN)
+                return strcpy(s, "-infinity");
+        int64_t day = t / (86400LL * USEC_PER_SEC), usec = t % (86400LL * USEC_PER_SEC);
+        if (usec < 0) {
+                day--;
+                usec += 86400LL * USEC_PER_SEC;
+        }
+        // Civil date from days since 1970-01-01, see http://howardhinnant.github.io/date_algorithms.html
+        int64_t z = day + POSTGRES_EPOCH / 86400 + 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        int64_t doe = z - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp = (5 * doy + 2) / 153;
+        int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+        int64_t year = yoe + era * 400 + (month <= 2);
+        int64_t second = usec / USEC_PER_SEC;
+        int n = snprintf(s, 64, "%04lld-%02d-%02d %02d:%02d:%02d", (long long)(year > 0 ? year : 1 - year), month, (int)(doy - (153 * mp + 2) / 5 + 1),
+                         (int)(second / 3600), (int)(second / 60 % 60), (int)(second % 60));
+        if (usec % USEC_PER_SEC) {
+                n += snprintf(s + n, 64 - n, ".%06d", (int)(usec % USEC_PER_SEC));
+                while (s[n - 1] == '0')
+                        s[--n] = 0;
+        }
+        snprintf(s + n, 64 - n, "%s%s", hasZone ? "+00" : "", year > 0 ? "" : " BC");
+        return s;
+}
+
+
+/* Format a numeric, base 10000 digits with a weight and display scale, as
+ the server's get_str_from_var() */
+static char *_formatNumeric(T R, int i, const uchar_t *v) {
+        int ndigits = (int16_t)_get16(v), weight = (int16_t)_get16(v + 2), sign = _get16(v + 4), dscale = _get16(v + 6);
+        switch (sign) {
+                case 0xC000: return strcpy(_buffer(R, i, 4), "NaN");
+                case 0xD000: return strcpy(_buffer(R, i, 9), "Infinity");
+                case 0xF000: return strcpy(_buffer(R, i, 10), "-Infinity");
+        }
+        char *s = _buffer(R, i, (weight > 0 ? weight + 1 : 1) * 4 + dscale + 8), *p = s;
+        if (sign == 0x4000)
+                *p++ = '-';
+        int d;
+        if (weight < 0) {
+                d = weight + 1;
+                *p++ = '0';
+        } else {
+                for (d = 0; d <= weight; d++) {
+                        int digit = d < ndigits ? _get16(v + 8 + d * 2) : 0;
+                        p += sprintf(p, d ? "%04d" : "%d", digit);
+                }
+        }
+        if (dscale > 0) {
+                *p++ = '.';
+                char *end = p + dscale;
+                for (int n = 0; n < dscale; d++, n += 4) {
+                        int digit = (d >= 0 && d < ndigits) ? _get16(v + 8 + d * 2) : 0;
+                        p += sprintf(p, "%04d", digit);
+                }
+                p = end;
+        }
+        *p = 0;
+        return s;
+}
+
+
+/* Returns the text of the binary value of column i in the current row */
+static const char *_toString(T R, int i, const uchar_t *v, int length) {
+        switch (PQftype(R->res, i)) {
+                case BOOLOID:
+                        return *v ? "t" : "f";
+                case INT2OID:
+                        snprintf(_buffer(R, i, 32), 32, "%d", (int16_t)_get16(v));
+                        break;
+                case INT4OID:
+                        snprintf(_buffer(R, i, 32), 32, "%d", (int32_t)_get32(v));
+                        break;
+                case OIDOID:
+                        snprintf(_buffer(R, i, 32), 32, "%u", _get32(v));
+                        break;
+                case INT8OID:
+                        snprintf(_buffer(R, i, 32), 32, "%lld", (long long)(int64_t)_get64(v));
+                        break;
+                case FLOAT4OID:
+                        return _formatFloat(_getFloat4(v), true, _buffer(R, i, 32));
+                case FLOAT8OID:
+                        return _formatFloat(_getFloat8(v), false, _buffer(R, i, 32));
+                case TIMESTAMPOID:
+                case TIMESTAMPTZOID:
+                        return _formatTimestamp((int64_t)_get64(v), PQftype(R->res, i) == TIMESTAMPTZOID, _buffer(R, i, 64));
+                case NUMERICOID:
+                        return _formatNumeric(R, i, v);
+                case UUIDOID:
+                        snprintf(_buffer(R, i, 40), 40, "%08x-%04x-%04x-%04x-%04x%08x", _get32(v), _get16(v + 4), _get16(v + 6), _get16(v + 8), _get16(v + 10), _get32(v + 12));
+                        break;
+                case BYTEAOID:
+                {
+                        // As the server's default bytea_output
+                        static const char hex[] = "0123456789abcdef";
+                        char *s = _buffer(R, i, length * 2 + 3);
+                        s[0] = '\\';
+                        s[1] = 'x';
+                        for (int j = 0; j < length; j++) {
+                                s[j * 2 + 2] = hex[v[j] >> 4];
+                                s[j * 2 + 3] = hex[v[j] & 0xF];
+                        }
+                        s[length * 2 + 2] = 0;
+                        return s;
+                }
+                default:
+                        // Text types are the same in both formats
+                        return (const char *)v;
+        }
+        return R->columns[i].s;
+}
+
+
+/* Read and discard the results which remain of a query */
+static void _drain(PGconn *db) {
+        PGresult *res;
+        while ((res = PQgetResult(db)))
+                PQclear(res);
+}
+
+
+/* Read the next chunk of rows of a streaming result. The last result of a 
+ query has no rows but is kept for its column descriptions */
+static bool _fetch(T R) {
+        PGresult *res = PQgetResult(R->db);
+        if (res && PARTIAL(PQresultStatus(res))) {
+                PQclear(R->res);
+                R->res = res;
+                R->rowCount = PQntuples(res);
+                R->currentRow = 0;
+                return true;
+        }
+        _drain(R->db);
+        R->db = NULL;
+        R->rowCount = 0;
+        if (! res || PQresultStatus(res) != PGRES_TUPLES_OK) {
+                char error[STRLEN];
+                snprintf(error, STRLEN, "%s", res ? PQresultErrorMessage(res) : "No result from server");
+                PQclear(res);
+                THROW(SQLException, "%s", error);
+        }
+        PQclear(R->res);
+        R->res = res;
+        return false;
+}
+
+
 /* ------------------------------------------------------------- Constructor */
 
 
-T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) {
+T PostgresqlResultSet_new(Connection_T delegator, PGconn *db, PGresult *res) {
         T R;
         assert(delegator);
         NEW(R);
@@ -127,6 +366,12 @@ T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) {
         R->currentRow = -1;
         R->columnCount = PQnfields(R->res);
         R->rowCount = PQntuples(R->res);
+        if (PARTIAL(PQresultStatus(res))) {
+                R->db = db;
+                R->fetchSize = Connection_getFetchSize(delegator);
+        }
+        if (R->columnCount > 0 && PQbinaryTuples(res))
+                R->columns = CALLOC(R->columnCount, sizeof(struct column_t));
         return R;
 }
 
@@ -136,6 +381,17 @@ T PostgresqlResultSet_new(Connection_T delegator, PGresult *res) {
 
 static void _free(T *R) {
         assert(R && *R);
+        if ((*R)->fetchSize) {
+                // The rows that remain must be read before the connection can be used again
+                if ((*R)->db)
+                        _drain((*R)->db);
+                PQclear((*R)->res);
+        }
+        if ((*R)->columns) {
+                for (int i = 0; i < (*R)->columnCount; i++)
+                        FREE((*R)->columns[i].s);
+                FREE((*R)->columns);
+        }
         FREE(*R);
 }
 
@@ -155,18 +411,32 @@ static const char *_getColumnName(T R, int columnIndex) {
 }
 
 
+static const char *_getString(T R, int columnIndex);
 static long _getColumnSize(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (PQgetisnull(R->res, R->currentRow, i))
                 return 0;
+        if (R->columns && PQftype(R->res, i) != BYTEAOID)
+                return strlen(_getString(R, columnIndex));
         return PQgetlength(R->res, R->currentRow, i);
 }
 
 
+static int _getFetchSize(T R) {
+        assert(R);
+        return R->fetchSize;
+}
+
+
 static bool _next(T R) {
         assert(R);
+        if (R->maxRows && (R->rows >= R->maxRows))
+                return false;
         R->currentRow += 1;
-        return (! ((R->currentRow >= R->rowCount) || (R->maxRows && (R->currentRow >= R->maxRows))));
+        if (R->currentRow >= R->rowCount && ! (R->db && _fetch(R)))
+                return false;
+        R->rows++;
+        return true;
 }
 
 
@@ -182,6 +452,8 @@ static const char *_getString(T R, int columnIndex) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (PQgetisnull(R->res, R->currentRow, i))
                 return NULL;
+        if (R->columns)
+                return _toString(R, i, (uchar_t *)PQgetvalue(R->res, R->currentRow, i), PQgetlength(R->res, R->currentRow, i));
         return PQgetvalue(R->res, R->currentRow, i);
 }
 
@@ -197,10 +469,110 @@ static const void *_getBlob(T R, int columnIndex, int *size) {
         int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
         if (PQgetisnull(R->res, R->currentRow, i))
                 return NULL;
+        if (R->columns) {
+                *size = PQgetlength(R->res, R->currentRow, i);
+                return PQgetvalue(R->res, R->currentRow, i);
+        }
         return _unescape_bytea((uchar_t*)PQgetvalue(R->res, R->currentRow, i), PQgetlength(R->res, R->currentRow, i), size);
 }
 
 
+static long long _getLLong(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0;
+        const uchar_t *v = (uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+        if (R->columns) {
+                switch (PQftype(R->res, i)) {
+                        case INT2OID:   return (int16_t)_get16(v);
+                        case INT4OID:   return (int32_t)_get32(v);
+                        case OIDOID:    return _get32(v);
+                        case INT8OID:   return (int64_t)_get64(v);
+                        case FLOAT4OID: return (long long)_getFloat4(v);
+                        case FLOAT8OID: return (long long)_getFloat8(v);
+                }
+        }
+        return Str_parseLLong(_getString(R, columnIndex));
+}
+
+
+static double _getDouble(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0.0;
+        const uchar_t *v = (uchar_t *)PQgetvalue(R->res, R->currentRow, i);
+        if (R->columns) {
+                switch (PQftype(R->res, i)) {
+                        case INT2OID:   return (int16_t)_get16(v);
+                        case INT4OID:   return (int32_t)_get32(v);
+                        case OIDOID:    return _get32(v);
+                        case INT8OID:   return (int64_t)_get64(v);
+                        case FLOAT4OID: return _getFloat4(v);
+                        case FLOAT8OID: return _getFloat8(v);
+                }
+        }
+        return Str_parseDouble(_getString(R, columnIndex));
+}
+
+
+static time_t _getTimestamp(T R, int columnIndex) {
+        assert(R);
+        int i = checkAndSetColumnIndex(columnIndex, R->columnCount);
+        if (PQgetisnull(R->res, R->currentRow, i))
+                return 0;
+        if (R->columns && (PQftype(R->res, i) == TIMESTAMPOID || PQftype(R->res, i) == TIMESTAMPTZOID)) {
+                int64_t t = (int64_t)_get64((uchar_t *)PQgetvalue(R->res, R->currentRow, i));
+                // Infinite timestamps are rejected by Time_toTimestamp() below
+                if (t != INT64_MAX && t != INT64_MIN) {
+                        int64_t seconds = t / USEC_PER_SEC - (t % USEC_PER_SEC < 0);
+                        return (time_t)(seconds + POSTGRES_EPOCH);
+                }
+        }
+        const char *s = _getString(R, columnIndex);
+        return STR_DEF(s) ? Time_toTimestamp(s) : 0;
+}
+
+
+/* ----------------------------------------------------- Protected methods */
+
+
+/**
+ * Read the first result of a query just sent with PQsendQuery or 
+ * PQsendQueryPrepared, in chunked rows mode with libpq 17 or later or else
+ * in single row mode. If the result has rows the query is still active and
+ * the rest are read by a ResultSet created with the result, otherwise the 
+ * query is finished. Returns NULL if the connection failed. The caller must
+ * clear the result
+ */
+PGresult *PostgresqlResultSet_stream(PGconn *db, int fetchSize) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        PQsetChunkedRowsMode(db, fetchSize);
+#else
+        PQsetSingleRowMode(db);
+#endif
+        PGresult *res = PQgetResult(db);
+        if (! res || ! PARTIAL(PQresultStatus(res)))
+                _drain(db);
+        return res;
+}
+
+
+/**
+ * Returns true if values of the type can be read in binary format
+ */
+bool PostgresqlResultSet_isBinary(Oid type) {
+        switch (type) {
+                case BOOLOID: case BYTEAOID: case CHAROID: case NAMEOID: case INT8OID: case INT2OID:
+                case INT4OID: case TEXTOID: case OIDOID: case JSONOID: case FLOAT4OID: case FLOAT8OID:
+                case BPCHAROID: case VARCHAROID: case TIMESTAMPOID: case TIMESTAMPTZOID: case NUMERICOID: case UUIDOID:
+                        return true;
+        }
+        return false;
+}
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -213,8 +585,12 @@ const struct Rop_T postgresqlrops = {
         .next           = _next,
         .isnull         = _isnull,
         .getString      = _getString,
-        .getBlob        = _getBlob
-        // get/setFetchSize is not applicable for Postgres or rather libpq
-        // getTimestamp and getDateTime is handled in ResultSet
+        .getBlob        = _getBlob,
+        .getLLong       = _getLLong,
+        .getDouble      = _getDouble,
+        .getTimestamp   = _getTimestamp,
+        .getFetchSize   = _getFetchSize
+        // setFetchSize is not applicable as libpq's row mode is set when the query is sent
+        // getDateTime is handled in ResultSet
 };
 
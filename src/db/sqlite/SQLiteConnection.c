@@ -114,8 +114,13 @@ static bool _setProperties(T C, char **error) {
 
 static void _free(T *C) {
         assert(C && *C);
+#if SQLITE_VERSION_NUMBER >= 3007014
+        // Does not block, the handle is released when the last statement is finalized
+        sqlite3_close_v2((*C)->db);
+#else
         while (sqlite3_close((*C)->db) == SQLITE_BUSY)
                 Time_usleep(10);
+#endif
         StringBuffer_free(&((*C)->sb));
         FREE(*C);
 }
@@ -237,6 +242,14 @@ static const char *_getLastError(T C) {
 }
 
 
+#if SQLITE_VERSION_NUMBER >= 3007011
+static int _maxParameters(T C) {
+        assert(C);
+        return sqlite3_limit(C->db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+}
+#endif
+
+
 /* ------------------------------------------------------------------------- */
 
 
@@ -254,6 +267,10 @@ const struct Cop_T sqlite3cops = {
         .execute	  = _execute,
         .executeQuery	  = _executeQuery,
         .prepareStatement = _prepareStatement,
-        .getLastError	  = _getLastError
+        .getLastError	  = _getLastError,
+#if SQLITE_VERSION_NUMBER >= 3007011
+        // Multi-row VALUES requires SQLite 3.7.11
+        .maxParameters    = _maxParameters
+#endif
 };
 
@@ -89,19 +89,61 @@ static void _setString(T P, int parameterIndex, const char *x) {
 }
 
 
-static void _setInt(T P, int parameterIndex, int x) {
+static void _setInteger(T P, int parameterIndex, long long x) {
         assert(P);
         sqlite3_reset(P->stmt);
-        P->lastError = sqlite3_bind_int(P->stmt, parameterIndex, x);
+        P->lastError = sqlite3_bind_int64(P->stmt, parameterIndex, x);
         if (P->lastError == SQLITE_RANGE)
                 THROW(SQLException, "Parameter index is out of range");
 }
 
 
-static void _setLLong(T P, int parameterIndex, long long x) {
+static void _setInt8(T P, int parameterIndex, int8_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt8(T P, int parameterIndex, uint8_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt16(T P, int parameterIndex, int16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt16(T P, int parameterIndex, uint16_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt32(T P, int parameterIndex, int32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt32(T P, int parameterIndex, uint32_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setInt64(T P, int parameterIndex, int64_t x) {
+        _setInteger(P, parameterIndex, x);
+}
+
+
+static void _setUInt64(T P, int parameterIndex, uint64_t x) {
         assert(P);
+        if (x <= INT64_MAX) {
+                _setInteger(P, parameterIndex, (long long)x);
+                return;
+        }
+        // SQLite integers are signed 64 bit, a larger value is bound as text so no digits are lost
+        char s[32];
+        snprintf(s, sizeof(s), "%llu", (unsigned long long)x);
         sqlite3_reset(P->stmt);
-        P->lastError = sqlite3_bind_int64(P->stmt, parameterIndex, x);
+        P->lastError = sqlite3_bind_text(P->stmt, parameterIndex, s, -1, SQLITE_TRANSIENT);
         if (P->lastError == SQLITE_RANGE)
                 THROW(SQLException, "Parameter index is out of range");
 }
@@ -153,6 +195,71 @@ static void _execute(T P) {
 }
 
 
+static void _bindValue(T P, int parameterIndex, BatchValue_T v) {
+        switch (v->type) {
+                case Batch_string:
+                        P->lastError = sqlite3_bind_text(P->stmt, parameterIndex, v->v.p, v->size, SQLITE_STATIC);
+                        break;
+                case Batch_int:
+                        P->lastError = sqlite3_bind_int64(P->stmt, parameterIndex, v->v.i);
+                        break;
+                case Batch_uint:
+                        if (v->v.u <= INT64_MAX) {
+                                P->lastError = sqlite3_bind_int64(P->stmt, parameterIndex, (sqlite3_int64)v->v.u);
+                        } else {
+                                // As _setUInt64(), a value larger than a signed 64 bit integer is bound as text
+                                char s[32];
+                                snprintf(s, sizeof(s), "%llu", (unsigned long long)v->v.u);
+                                P->lastError = sqlite3_bind_text(P->stmt, parameterIndex, s, -1, SQLITE_TRANSIENT);
+                        }
+                        break;
+                case Batch_double:
+                        P->lastError = sqlite3_bind_double(P->stmt, parameterIndex, v->v.d);
+                        break;
+                case Batch_timestamp:
+                        P->lastError = sqlite3_bind_int64(P->stmt, parameterIndex, v->v.t);
+                        break;
+                case Batch_blob:
+                        P->lastError = sqlite3_bind_blob(P->stmt, parameterIndex, v->v.p, v->size, SQLITE_STATIC);
+                        break;
+                default:
+                        P->lastError = sqlite3_bind_null(P->stmt, parameterIndex);
+                        break;
+        }
+}
+
+
+/* In auto-commit mode each step is a transaction of its own and commit
+ cost dominates, so the batch is executed in a savepoint */
+static void _executeBatch(T P, Batch_T batch) {
+        assert(P);
+        bool autocommit = sqlite3_get_autocommit(P->db);
+        if (autocommit && (P->lastError = zdb_sqlite3_exec(P->db, "SAVEPOINT zdb_batch;")) != SQLITE_OK)
+                THROW(SQLException, "%s", sqlite3_errmsg(P->db));
+        for (int row = 0; row < batch->rows; row++) {
+                sqlite3_reset(P->stmt);
+                for (int i = 0; i < batch->columns; i++)
+                        _bindValue(P, i + 1, batchValue(batch, row, i));
+                P->lastError = zdb_sqlite3_step(P->stmt);
+                if (P->lastError != SQLITE_DONE)
+                        break;
+                batch->rowsChanged[row] = sqlite3_changes(P->db);
+        }
+        sqlite3_reset(P->stmt);
+        if (P->lastError == SQLITE_DONE && autocommit)
+                P->lastError = zdb_sqlite3_exec(P->db, "RELEASE zdb_batch;");
+        else if (P->lastError == SQLITE_DONE)
+                P->lastError = SQLITE_OK;
+        if (P->lastError != SQLITE_OK) {
+                char error[STRLEN];
+                snprintf(error, STRLEN, "%s", P->lastError == SQLITE_ROW ? "Select statement not allowed in PreparedStatement_executeBatch()" : sqlite3_errmsg(P->db));
+                if (autocommit)
+                        zdb_sqlite3_exec(P->db, "ROLLBACK TO zdb_batch; RELEASE zdb_batch;");
+                THROW(SQLException, "%s", error);
+        }
+}
+
+
 static ResultSet_T _executeQuery(T P) {
         assert(P);
         if (P->lastError == SQLITE_OK)
@@ -181,15 +288,22 @@ const struct Pop_T sqlite3pops = {
         .name           = "sqlite",
         .free           = _free,
         .setString      = _setString,
-        .setInt         = _setInt,
-        .setLLong       = _setLLong,
+        .setInt8        = _setInt8,
+        .setUInt8       = _setUInt8,
+        .setInt16       = _setInt16,
+        .setUInt16      = _setUInt16,
+        .setInt32       = _setInt32,
+        .setUInt32      = _setUInt32,
+        .setInt64       = _setInt64,
+        .setUInt64      = _setUInt64,
         .setDouble      = _setDouble,
         .setTimestamp   = _setTimestamp,
         .setBlob        = _setBlob,
         .execute        = _execute,
         .executeQuery   = _executeQuery,
         .rowsChanged    = _rowsChanged,
-        .parameterCount = _parameterCount
+        .parameterCount = _parameterCount,
+        .executeBatch   = _executeBatch
 };
 
 
@@ -54,6 +54,11 @@
  * <a href="http://www.ietf.org/rfc/rfc2732.txt">RFC2732</a> by enclosing the 
  * address in [brackets]. For instance, mysql://[2010:836B:4179::836B:4179]:3306/test
  *
+ * The authority part may list several hosts separated by comma, each with
+ * an optional port. For instance, mysql://db1:3306,db2:3306,db3/test. 
+ * URL_getHost() and URL_getPort() return the first host, use 
+ * URL_getHostCount(), URL_getHostAt() and URL_getPortAt() to get them all.
+ *
  * For more information about the URL syntax and specification, see,
  * <a href="ftp://ftp.rfc-editor.org/in-notes/rfc2396.txt">RFC2396 -
  * Uniform Resource Identifiers (URI): Generic Syntax</a>
@@ -142,6 +147,33 @@ const char *URL_getHost(T U);
 int URL_getPort(T U);
 
 
+/**
+ * Get the number of hosts in the URL. 
+ * @param U An URL object
+ * @return The number of hosts listed in the authority part of the URL, 
+ * 0 if the URL does not have a host
+ */
+int URL_getHostCount(T U);
+
+
+/**
+ * Get a hostname of a multi-host URL.
+ * @param U An URL object
+ * @param index The index of the host, 0 <= index < URL_getHostCount()
+ * @return The hostname at index
+ */
+const char *URL_getHostAt(T U, int index);
+
+
+/**
+ * Get a port of a multi-host URL.
+ * @param U An URL object
+ * @param index The index of the host, 0 <= index < URL_getHostCount()
+ * @return The port number of the host at index or -1 if not specified
+ */
+int URL_getPortAt(T U, int index);
+
+
 /**
  * Get the path of the URL.
  * @param U An URL object
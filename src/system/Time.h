@@ -125,6 +125,16 @@ time_t Time_now(void);
 long long Time_milli(void);
 
 
+/**
+ * Returns the time since the Epoch (00:00:00 UTC, January 1, 1970),
+ * measured in microseconds. 
+ * @return A 64 bits long representing the system's notion of the 
+ * current GMT time in microseconds
+ * @exception AssertException If time could not be obtained
+ */
+long long Time_micro(void);
+
+
 /**
  * This method suspend the calling process or Thread for
  * <code>u</code> micro seconds.
@@ -69,30 +69,28 @@ static inline void _append(T S, const char *s, va_list ap) {
 }
 
 
-/* Replace all occurences of ? in this string buffer with prefix[1..99] */
+/* Replace all occurences of ? in this string buffer with prefix[1..65535] */
 static int _prepare(T S, char prefix) {
         int n, i;
         for (n = i = 0; S->buffer[i]; i++) if (S->buffer[i] == '?') n++;
-        if (n > 99)
-                THROW(SQLException, "Max 99 parameters are allowed in a prepared statement. Found %d parameters in statement", n);
+        if (n > 65535)
+                THROW(SQLException, "Max 65535 parameters are allowed in a prepared statement. Found %d parameters in statement", n);
         else if (n) {
-                int j, xl;
-                char x[3] = {prefix};
-                int required = (n * 2) + S->used;
-                if (required >= S->length) {
-                        S->length = required;
-                        RESIZE(S->buffer, S->length);
+                // Each ? becomes prefix and up to 5 digits
+                int length = S->used + (n * 5) + 1;
+                uchar_t *buffer = ALLOC(length);
+                int j, k;
+                for (i = j = 0, k = 1; i < S->used; i++) {
+                        if (S->buffer[i] == '?')
+                                j += snprintf((char *)buffer + j, length - j, "%c%d", prefix, k++);
+                        else
+                                buffer[j++] = S->buffer[i];
                 }
-                for (i = 0, j = 1; (j <= n); i++) {
-                        if (S->buffer[i] == '?') {
-                                if(j<10){xl=2;x[1]=j+'0';}else{xl=3;x[1]=(j/10)+'0';x[2]=(j%10)+'0';}
-                                memmove(S->buffer + i + xl, S->buffer + i + 1, (S->used - (i + 1)));
-                                memmove(S->buffer + i, x, xl);
-                                S->used += xl - 1;
-                                j++;
-                        }
-                }
-                S->buffer[S->used] = 0;
+                buffer[j] = 0;
+                FREE(S->buffer);
+                S->buffer = buffer;
+                S->length = length;
+                S->used = j;
         }
         return n;
 }
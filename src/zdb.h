@@ -49,6 +49,7 @@ extern "C" {
 #include <URL.h>
 #include <ResultSet.h>
 #include <PreparedStatement.h>
+#include <BulkLoader.h>
 #include <Connection.h>
 #include <ConnectionPool.h>
 
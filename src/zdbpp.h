@@ -25,6 +25,7 @@
 #define _ZDBPP_H_
 
 #include "zdb.h"
+#include <list>
 #include <tuple>
 #include <string>
 #include <utility>
@@ -319,10 +320,30 @@ namespace zdb {
             return PreparedStatement_rowsChanged(t_);
         }
         
+        void addBatch() {
+            PreparedStatement_addBatch(t_);
+        }
+        
+        int executeBatch() {
+            except_wrapper( RETURN PreparedStatement_executeBatch(t_) );
+        }
+        
+        long long getBatchRowsChanged(int index) {
+            except_wrapper( RETURN PreparedStatement_getBatchRowsChanged(t_, index) );
+        }
+        
+        void clearBatch() {
+            PreparedStatement_clearBatch(t_);
+        }
+        
         int getParameterCount() {
             return PreparedStatement_getParameterCount(t_);
         }
         
+        int getBatchSize() {
+            return PreparedStatement_getBatchSize(t_);
+        }
+        
     public:
         void bind(int parameterIndex, const char *x) {
             this->setString(parameterIndex, x);
@@ -378,6 +399,67 @@ namespace zdb {
         PreparedStatement_T t_;
     };
     
+    class BulkLoader : private noncopyable
+    {
+    public:
+        operator BulkLoader_T() {
+            return t_;
+        }
+        
+        BulkLoader(BulkLoader&& r)
+        :t_(r.t_)
+        {
+            r.t_ = nullptr;
+        }
+        
+    protected:
+        friend class Connection;
+        
+        BulkLoader(BulkLoader_T t)
+        :t_(t)
+        {}
+        
+    public:
+        void setString(int columnIndex, const char *x) {
+            except_wrapper( BulkLoader_setString(t_, columnIndex, x) );
+        }
+        
+        void setInt32(int columnIndex, int32_t x) {
+            except_wrapper( BulkLoader_setInt32(t_, columnIndex, x) );
+        }
+        
+        void setInt64(int columnIndex, int64_t x) {
+            except_wrapper( BulkLoader_setInt64(t_, columnIndex, x) );
+        }
+        
+        void setDouble(int columnIndex, double x) {
+            except_wrapper( BulkLoader_setDouble(t_, columnIndex, x) );
+        }
+        
+        void setBlob(int columnIndex, const void *x, int size) {
+            except_wrapper( BulkLoader_setBlob(t_, columnIndex, x, size) );
+        }
+        
+        void setTimestamp(int columnIndex, time_t x) {
+            except_wrapper( BulkLoader_setTimestamp(t_, columnIndex, x) );
+        }
+        
+        void appendRow() {
+            except_wrapper( BulkLoader_appendRow(t_) );
+        }
+        
+        long long finish() {
+            except_wrapper( RETURN BulkLoader_finish(t_) );
+        }
+        
+        long long getRows() {
+            return BulkLoader_getRows(t_);
+        }
+        
+    private:
+        BulkLoader_T t_;
+    };
+    
     class Connection : private noncopyable
     {
     public:
@@ -458,6 +540,14 @@ namespace zdb {
             except_wrapper( Connection_rollback(t_) );
         }
         
+        void beginPipeline() {
+            except_wrapper( Connection_beginPipeline(t_) );
+        }
+        
+        void endPipeline() {
+            except_wrapper( Connection_endPipeline(t_) );
+        }
+        
         long long lastRowId() {
             return Connection_lastRowId(t_);
         }
@@ -506,10 +596,21 @@ namespace zdb {
                            );
         }
         
+        BulkLoader bulkLoad(const char *table, const char *columns) {
+            except_wrapper(
+                           BulkLoader_T l = Connection_bulkLoad(t_, table, columns);
+                           RETURN BulkLoader(l);
+                           );
+        }
+        
         const char *getLastError() {
             return Connection_getLastError(t_);
         }
         
+        const char *getReplicationPosition() {
+            except_wrapper( RETURN Connection_getReplicationPosition(t_) );
+        }
+        
         static bool isSupported(const char *url) {
             return Connection_isSupported(url);
         }
@@ -563,6 +664,22 @@ namespace zdb {
             return ConnectionPool_getMaxConnections(t_);
         }
         
+        void setMinIdle(int minIdle) {
+            ConnectionPool_setMinIdle(t_, minIdle);
+        }
+        
+        int getMinIdle() {
+            return ConnectionPool_getMinIdle(t_);
+        }
+        
+        void setTargetUtilization(int percent) {
+            ConnectionPool_setTargetUtilization(t_, percent);
+        }
+        
+        int getTargetUtilization() {
+            return ConnectionPool_getTargetUtilization(t_);
+        }
+        
         void setConnectionTimeout(int connectionTimeout) {
             ConnectionPool_setConnectionTimeout(t_, connectionTimeout);
         }
@@ -575,10 +692,90 @@ namespace zdb {
             ConnectionPool_setAbortHandler(t_, abortHandler);
         }
         
+        void setConnectionInitializer(void(*initializer)(Connection_T connection)) {
+            ConnectionPool_setConnectionInitializer(t_, initializer);
+        }
+        
+        void setInitSQL(const char *sql) {
+            ConnectionPool_setInitSQL(t_, sql);
+        }
+        
+        const char *getInitSQL() {
+            return ConnectionPool_getInitSQL(t_);
+        }
+        
+        void addPreparedStatement(const char *sql) {
+            ConnectionPool_addPreparedStatement(t_, sql);
+        }
+        
+        void setLeakDetection(int threshold, void(*leakHandler)(const char *tag, long long heldTime) = nullptr) {
+            ConnectionPool_setLeakDetection(t_, threshold, leakHandler);
+        }
+        
+        int getLeakThreshold() {
+            return ConnectionPool_getLeakThreshold(t_);
+        }
+        
+        void setLeakReclaim(bool reclaim) {
+            ConnectionPool_setLeakReclaim(t_, reclaim);
+        }
+        
+        void setPriorityLimits(Priority_T priority, int reserved, int limit) {
+            ConnectionPool_setPriorityLimits(t_, priority, reserved, limit);
+        }
+        
+        void setPriorityQueue(Priority_T priority, int weight, int maxWaiting) {
+            ConnectionPool_setPriorityQueue(t_, priority, weight, maxWaiting);
+        }
+        
+        void setStatementCache(int size, int memory) {
+            ConnectionPool_setStatementCache(t_, size, memory);
+        }
+        
+        int getStatementCacheSize() {
+            return ConnectionPool_getStatementCacheSize(t_);
+        }
+        
+        void setBatchRewrite(bool rewrite) {
+            ConnectionPool_setBatchRewrite(t_, rewrite);
+        }
+        
+        bool getBatchRewrite() {
+            return ConnectionPool_getBatchRewrite(t_);
+        }
+        
+        void setDeferredReset(bool deferred) {
+            ConnectionPool_setDeferredReset(t_, deferred);
+        }
+        
+        bool getDeferredReset() {
+            return ConnectionPool_getDeferredReset(t_);
+        }
+        
+        void setCircuitBreaker(int failures, int maxBackoff) {
+            ConnectionPool_setCircuitBreaker(t_, failures, maxBackoff);
+        }
+        
+        Circuit_T getCircuitState() {
+            return ConnectionPool_getCircuitState(t_);
+        }
+        
+        void setValidation(Validation_T policy, int idleTime = 0) {
+            ConnectionPool_setValidation(t_, policy, idleTime);
+        }
+        
+        Validation_T getValidation() {
+            return ConnectionPool_getValidation(t_);
+        }
+        
         void setReaper(int sweepInterval) {
             ConnectionPool_setReaper(t_, sweepInterval);
         }
         
+        Statistics_T getStatistics() {
+            return ConnectionPool_getStatistics(t_);
+        }
+        
         int size() {
             return ConnectionPool_size(t_);
         }
@@ -603,6 +800,55 @@ namespace zdb {
             return Connection(C);
         }
         
+        Connection getConnection(int ms) {
+            Connection_T C = ConnectionPool_getConnectionWithTimeout(t_, ms);
+            if (!C) {
+                throw sql_exception("timed out waiting for a connection (got null connection)!");
+            }
+            return Connection(C);
+        }
+        
+        Connection getConnection(Priority_T priority, int ms) {
+            Connection_T C = ConnectionPool_getConnectionWithPriority(t_, priority, ms);
+            if (!C) {
+                throw sql_exception("no connection available for the priority class (got null connection)!");
+            }
+            return Connection(C);
+        }
+        
+        Connection getConnection(const char *tag) {
+            Connection_T C = ConnectionPool_getConnectionWithTag(t_, tag);
+            if (!C) {
+                throw sql_exception("maxConnection is reached (got null connection)!");
+            }
+            return Connection(C);
+        }
+        
+        Connection getReadConnection(const char *position = nullptr) {
+            Connection_T C = ConnectionPool_getReadConnection(t_, position);
+            if (!C) {
+                throw sql_exception("maxConnection is reached (got null connection)!");
+            }
+            return Connection(C);
+        }
+        
+        void addReplica(const char *url) {
+            replicas_.emplace_back(url);
+            if (!replicas_.back()) {
+                replicas_.pop_back();
+                throw sql_exception("Invalid URL");
+            }
+            ConnectionPool_addReplica(t_, replicas_.back());
+        }
+        
+        void setMaxReplicationLag(int ms) {
+            ConnectionPool_setMaxReplicationLag(t_, ms);
+        }
+        
+        int getMaxReplicationLag() {
+            return ConnectionPool_getMaxReplicationLag(t_);
+        }
+        
         void returnConnection(Connection& con) {
             con.close();
         }
@@ -617,6 +863,7 @@ namespace zdb {
         
     private:
         URL url_;
+        std::list<URL> replicas_;
         ConnectionPool_T t_;
     };
     
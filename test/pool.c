@@ -4,13 +4,16 @@
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <stdlib.h>
 
 #include "URL.h"
 #include "Thread.h"
 #include "Vector.h"
+#include "system/Time.h"
 #include "ResultSet.h"
 #include "PreparedStatement.h"
+#include "BulkLoader.h"
 #include "Connection.h"
 #include "ConnectionPool.h"
 #include "AssertException.h"
@@ -39,6 +42,75 @@ static void TabortHandler(const char *error) {
         exit(1);
 }
 
+static void *TdelayedClose(void *p) {
+        usleep(100000);
+        Connection_close(p);
+        return NULL;
+}
+
+static void *TcheckoutWorker(void *p) {
+        ConnectionPool_T pool = p;
+        for (int i = 0; i < 500; i++) {
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(ConnectionPool_active(pool) <= ConnectionPool_getMaxConnections(pool));
+                Connection_close(con);
+        }
+        return NULL;
+}
+
+static void *TpriorityWaiter(void *p) {
+        Connection_T con = ConnectionPool_getConnectionWithPriority(p, Priority_background, 5000);
+        assert(con);
+        Connection_close(con);
+        return NULL;
+}
+
+// Count the batch class connections held at once to check that its limit is never exceeded
+static int held = 0;
+static int maxHeld = 0;
+static Mutex_T heldMutex = PTHREAD_MUTEX_INITIALIZER;
+static void *TlimitedWorker(void *p) {
+        for (int i = 0; i < 500; i++) {
+                Connection_T con = ConnectionPool_getConnectionWithPriority(p, Priority_batch, 0);
+                if (! con)
+                        continue;
+                LOCK(heldMutex)
+                {
+                        if (++held > maxHeld)
+                                maxHeld = held;
+                }
+                END_LOCK;
+                usleep(10);
+                LOCK(heldMutex)
+                {
+                        held--;
+                }
+                END_LOCK;
+                Connection_close(con);
+        }
+        return NULL;
+}
+
+// Initial connections are opened in parallel so the initializer may run concurrently
+static int initialized = 0;
+static Mutex_T initializedMutex = PTHREAD_MUTEX_INITIALIZER;
+static void Tinitializer(Connection_T con) {
+        assert(con);
+        LOCK(initializedMutex)
+        {
+                initialized++;
+        }
+        END_LOCK;
+}
+
+static int leaks = 0;
+static void TleakHandler(const char *tag, long long heldTime) {
+        assert(tag && strstr(tag, "pool.c:"));
+        assert(heldTime >= 100);
+        leaks++;
+}
+
 static void testPool(const char *testURL) {
         URL_T url;
         char *schema;
@@ -308,6 +380,37 @@ static void testPool(const char *testURL) {
                         assert(ResultSet_getFetchSize(fs) == 12);
                         printf("success\n");
                 }
+                // Test streaming for Postgres, where fetch-size means rows are read as the ResultSet advances
+                if (Str_startsWith(testURL, "postgres")) {
+                        printf("\tResult: check fetch-size streaming..");
+                        assert(Connection_getFetchSize(con) == SQL_DEFAULT_PREFETCH_ROWS);
+                        Connection_setFetchSize(con, 5);
+                        ResultSet_T fs = Connection_executeQuery(con, "select id, name from zild_t order by id;");
+                        assert(ResultSet_getFetchSize(fs) == 5);
+                        assert(Str_isEqual(ResultSet_getColumnName(fs, 2), "name"));
+                        for (i = 0; ResultSet_next(fs); i++)
+                                assert(ResultSet_getInt(fs, 1) > 0);
+                        assert(i == 12);
+                        // A ResultSet closed before it is read to the end must not leave the Connection busy
+                        pre = Connection_prepareStatement(con, "select name from zild_t where id > ?;");
+                        PreparedStatement_setInt32(pre, 1, 0);
+                        fs = PreparedStatement_executeQuery(pre);
+                        assert(ResultSet_next(fs));
+                        PreparedStatement_setInt32(pre, 1, 6);
+                        fs = PreparedStatement_executeQuery(pre);
+                        for (i = 0; ResultSet_next(fs); i++);
+                        assert(i == 6);
+                        // No rows and max rows
+                        fs = Connection_executeQuery(con, "select name from zild_t where id < 0;");
+                        assert(! ResultSet_next(fs));
+                        Connection_setMaxRows(con, 3);
+                        fs = Connection_executeQuery(con, "select name from zild_t;");
+                        for (i = 0; ResultSet_next(fs); i++);
+                        assert(i == 3);
+                        Connection_setMaxRows(con, 0);
+                        assert(Connection_executeQuery(con, "select count(*) from zild_t;"));
+                        printf("success\n");
+                }
                 
                 /* Need to close and release statements before
                    we can drop the table, sqlite need this */
@@ -700,6 +803,1073 @@ static void testPool(const char *testURL) {
         }
         printf("=> Test10: OK\n\n");
 
+        printf("=> Test11: Concurrent checkout and return\n");
+        {
+                Thread_T threads[8];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                // A thread should get back the connection it returned last
+                Connection_T con = ConnectionPool_getConnection(pool);
+                Connection_close(con);
+                assert(con == ConnectionPool_getConnection(pool));
+                Connection_close(con);
+                for (int i = 0; i < 8; i++)
+                        Thread_create(threads[i], TcheckoutWorker, pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_join(threads[i]);
+                assert(ConnectionPool_active(pool) == 0);
+                assert(ConnectionPool_size(pool) <= ConnectionPool_getMaxConnections(pool));
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test11: OK\n\n");
+
+        printf("=> Test12: Wait for a connection with timeout\n");
+        {
+                Vector_T v = Vector_new(4);
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setMaxConnections(pool, 2);
+                ConnectionPool_start(pool);
+                Vector_push(v, ConnectionPool_getConnection(pool));
+                Vector_push(v, ConnectionPool_getConnection(pool));
+                assert(! ConnectionPool_getConnection(pool));
+                long long start = Time_milli();
+                assert(! ConnectionPool_getConnectionWithTimeout(pool, 200));
+                assert(Time_milli() - start >= 200);
+                // A connection returned by another thread is handed to the waiter
+                Thread_T thread;
+                Thread_create(thread, TdelayedClose, Vector_pop(v));
+                Connection_T con = ConnectionPool_getConnectionWithTimeout(pool, 5000);
+                assert(con);
+                Thread_join(thread);
+                Connection_close(con);
+                Connection_close(Vector_pop(v));
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                Vector_free(&v);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test12: OK\n\n");
+
+        printf("=> Test13: Background min-idle replenishment\n");
+        {
+                Vector_T v = Vector_new(4);
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 4);
+                ConnectionPool_setMinIdle(pool, 2);
+                assert(ConnectionPool_getMinIdle(pool) == 2);
+                ConnectionPool_start(pool);
+                // The builder tops up the pool to minIdle idle connections
+                for (int i = 0; i < 50 && ConnectionPool_size(pool) < 2; i++)
+                        Time_usleep(10000);
+                assert(ConnectionPool_size(pool) == 2);
+                // Callers wait for the builder instead of opening connections
+                for (int i = 0; i < 4; i++) {
+                        Connection_T con = ConnectionPool_getConnectionWithTimeout(pool, 1000);
+                        assert(con);
+                        Vector_push(v, con);
+                }
+                assert(ConnectionPool_size(pool) == 4);
+                // At maxConnections there is nothing to wait for
+                long long start = Time_milli();
+                assert(! ConnectionPool_getConnection(pool));
+                assert(Time_milli() - start < 100);
+                while (! Vector_isEmpty(v))
+                        Connection_close(Vector_pop(v));
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                Vector_free(&v);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test13: OK\n\n");
+
+        printf("=> Test14: Statistics\n");
+        {
+                char buf[16384];
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(! ConnectionPool_getConnection(pool));
+                Time_usleep(2000);
+                Connection_close(con);
+                Statistics_T s = ConnectionPool_getStatistics(pool);
+                assert(s.checkouts == 1);
+                assert(s.timeouts == 1);
+                assert(s.creations == 1);
+                assert(s.size == 1 && s.active == 0);
+                assert(s.holdTimeSum >= 2000);
+                long long count = 0;
+                for (int i = 0; i < LIBZDB_HISTOGRAM_BUCKETS; i++)
+                        count += s.holdTime[i];
+                assert(count == 1);
+                int n = ConnectionPool_formatStatistics(&s, "test", buf, sizeof(buf));
+                assert(n > 0 && n < (int)sizeof(buf) && strlen(buf) == n);
+                assert(strstr(buf, "libzdb_pool_checkouts_total{pool=\"test\"} 1\n"));
+                assert(strstr(buf, "libzdb_pool_hold_seconds_count{pool=\"test\"} 1\n"));
+                // Truncated output reports the required length
+                assert(ConnectionPool_formatStatistics(&s, "test", buf, 10) == n && strlen(buf) == 9);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test14: OK\n\n");
+
+        printf("=> Test15: Adaptive pool sizing\n");
+        {
+                Vector_T v = Vector_new(8);
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 10);
+                ConnectionPool_setReaper(pool, 1);
+                ConnectionPool_setTargetUtilization(pool, 50);
+                assert(ConnectionPool_getTargetUtilization(pool) == 50);
+                ConnectionPool_start(pool);
+                for (int i = 0; i < 6; i++)
+                        Vector_push(v, ConnectionPool_getConnection(pool));
+                while (! Vector_isEmpty(v))
+                        Connection_close(Vector_pop(v));
+                assert(ConnectionPool_size(pool) == 6);
+                // Without load the controller shrinks the pool toward initialConnections
+                for (int i = 0; i < 40 && ConnectionPool_size(pool) == 6; i++)
+                        Time_usleep(100000);
+                assert(ConnectionPool_size(pool) < 6);
+                assert(ConnectionPool_size(pool) >= 1);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                Vector_free(&v);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test15: OK\n\n");
+
+        printf("=> Test16: Incremental reaping\n");
+        {
+                Vector_T v = Vector_new(40);
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 40);
+                ConnectionPool_setConnectionTimeout(pool, 1);
+                ConnectionPool_start(pool);
+                for (int i = 0; i < 40; i++)
+                        Vector_push(v, ConnectionPool_getConnection(pool));
+                while (! Vector_isEmpty(v))
+                        Connection_close(Vector_pop(v));
+                sleep(2);
+                // Each pass examines at most 32 connections
+                assert(ConnectionPool_reapConnections(pool) == 32);
+                assert(ConnectionPool_size(pool) == 8);
+                assert(ConnectionPool_reapConnections(pool) == 7);
+                assert(ConnectionPool_size(pool) == 1);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                Vector_free(&v);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test16: OK\n\n");
+
+        printf("=> Test17: Read replicas\n");
+        {
+                url = URL_new(testURL);
+                URL_T replica = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_addReplica(pool, replica);
+                assert(ConnectionPool_replicas(pool) == 1);
+                ConnectionPool_start(pool);
+                // Reads go to the replica
+                Connection_T con = ConnectionPool_getReadConnection(pool, NULL);
+                assert(con);
+                assert(Connection_getURL(con) == replica);
+                Connection_close(con);
+                // Without replication positions, reads after a write go to the primary
+                con = ConnectionPool_getReadConnection(pool, "0/0");
+                assert(con);
+                if (! Connection_getReplicationPosition(con))
+                        assert(Connection_getURL(con) == url);
+                Connection_close(con);
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&replica);
+                URL_free(&url);
+        }
+        printf("=> Test17: OK\n\n");
+
+        printf("=> Test18: Connection initializer and pre-prepared statements\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setConnectionInitializer(pool, Tinitializer);
+                ConnectionPool_setInitSQL(pool, NULL);
+                assert(ConnectionPool_getInitSQL(pool) == NULL);
+                ConnectionPool_addPreparedStatement(pool, "select 1");
+                ConnectionPool_start(pool);
+                assert(initialized == 2);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                // The statement prepared when the connection was opened is returned
+                PreparedStatement_T p = Connection_prepareStatement(con, "select 1");
+                ResultSet_T r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 1);
+                // Preparing the same SQL again in this check-out gives a statement of its own
+                assert(p != Connection_prepareStatement(con, "select 1"));
+                Connection_close(con);
+                // and kept when the connection is returned
+                con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(p == Connection_prepareStatement(con, "select 1"));
+                r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test18: OK\n\n");
+
+        printf("=> Test19: Leak detection\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_setLeakDetection(pool, 100, TleakHandler);
+                assert(ConnectionPool_getLeakThreshold(pool) == 100);
+                ConnectionPool_setLeakReclaim(pool, true);
+                ConnectionPool_setReaper(pool, 1);
+                ConnectionPool_start(pool);
+                Connection_T leaked = ConnectionPool_getConnectionWithTag(pool, LIBZDB_CALLER);
+                assert(leaked);
+                assert(ConnectionPool_getConnection(pool) == NULL);
+                sleep(2);
+                // Reported once and reclaimed so the capacity is regained
+                assert(leaks == 1);
+                assert(ConnectionPool_getStatistics(pool).leaks == 1);
+                assert(ConnectionPool_active(pool) == 0);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                // The leaked connection is still usable and closed when returned
+                assert(Connection_ping(leaked));
+                Connection_close(leaked);
+                assert(ConnectionPool_active(pool) == 1);
+                Connection_close(con);
+                assert(ConnectionPool_size(pool) == 1);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test19: OK\n\n");
+
+        printf("=> Test20: Priority classes\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 3);
+                ConnectionPool_setPriorityLimits(pool, Priority_interactive, 1, 0);
+                ConnectionPool_setPriorityLimits(pool, Priority_batch, 0, 1);
+                ConnectionPool_setPriorityQueue(pool, Priority_background, 1, 1);
+                ConnectionPool_start(pool);
+                // Batch is limited to one connection
+                Connection_T batch = ConnectionPool_getConnectionWithPriority(pool, Priority_batch, 0);
+                assert(batch);
+                assert(! ConnectionPool_getConnectionWithPriority(pool, Priority_batch, 0));
+                // Background cannot take the connection reserved for interactive
+                Connection_T background = ConnectionPool_getConnectionWithPriority(pool, Priority_background, 0);
+                assert(background);
+                assert(! ConnectionPool_getConnectionWithPriority(pool, Priority_background, 0));
+                Connection_T interactive = ConnectionPool_getConnectionWithPriority(pool, Priority_interactive, 0);
+                assert(interactive);
+                assert(ConnectionPool_active(pool) == 3);
+                // The background queue holds one waiter, the next request is shed at once
+                Thread_T thread;
+                Thread_create(thread, TpriorityWaiter, pool);
+                usleep(100000);
+                long long start = Time_milli();
+                assert(! ConnectionPool_getConnectionWithPriority(pool, Priority_background, 1000));
+                assert(Time_milli() - start < 1000);
+                assert(ConnectionPool_getStatistics(pool).shed == 1);
+                // The waiter is handed the returned connection
+                Connection_close(background);
+                Thread_join(thread);
+                Connection_close(batch);
+                Connection_close(interactive);
+                assert(ConnectionPool_active(pool) == 0);
+                // Concurrent check-outs never exceed the batch class limit
+                Thread_T workers[8];
+                for (int i = 0; i < 8; i++)
+                        Thread_create(workers[i], TlimitedWorker, pool);
+                for (int i = 0; i < 8; i++)
+                        Thread_join(workers[i]);
+                assert(maxHeld == 1);
+                assert(ConnectionPool_active(pool) == 0);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test20: OK\n\n");
+
+        printf("=> Test21: Parallel start and stop\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setMaxConnections(pool, 3 * SQL_MAX_CONNECT_THREADS);
+                ConnectionPool_setInitialConnections(pool, 3 * SQL_MAX_CONNECT_THREADS);
+                initialized = 0;
+                ConnectionPool_setConnectionInitializer(pool, Tinitializer);
+                ConnectionPool_start(pool);
+                assert(ConnectionPool_size(pool) == 3 * SQL_MAX_CONNECT_THREADS);
+                assert(initialized == 3 * SQL_MAX_CONNECT_THREADS);
+                assert(ConnectionPool_getStatistics(pool).creations == 3 * SQL_MAX_CONNECT_THREADS);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(Connection_ping(con));
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                assert(ConnectionPool_size(pool) == 0);
+                // The pool can be started again after it is stopped
+                ConnectionPool_start(pool);
+                assert(ConnectionPool_size(pool) == 3 * SQL_MAX_CONNECT_THREADS);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test21: OK\n\n");
+
+        if (Str_startsWith(testURL, "sqlite")) {
+                printf("=> Test22: Circuit breaker\n");
+                // SQLite cannot open a database in a directory which does not exist
+                char *dir = Str_cat("/tmp/zdb-breaker-%d", getpid());
+                char *db = Str_cat("%s/test.db", dir);
+                url = URL_create("sqlite://%s", db);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 0);
+                ConnectionPool_setCircuitBreaker(pool, 2, 1000);
+                ConnectionPool_start(pool);
+                assert(ConnectionPool_getCircuitState(pool) == Circuit_closed);
+                assert(! ConnectionPool_getConnection(pool));
+                assert(! ConnectionPool_getConnection(pool));
+                assert(ConnectionPool_getCircuitState(pool) == Circuit_open);
+                assert(ConnectionPool_getStatistics(pool).trips == 1);
+                // While open, requests fail without a connect attempt
+                assert(! ConnectionPool_getConnection(pool));
+                assert(ConnectionPool_getStatistics(pool).failures == 2);
+                // After the backoff, at most 1000 ms, a failed probe opens the circuit again
+                usleep(1100000);
+                assert(! ConnectionPool_getConnection(pool));
+                assert(ConnectionPool_getStatistics(pool).failures == 3);
+                assert(ConnectionPool_getCircuitState(pool) == Circuit_open);
+                assert(ConnectionPool_getStatistics(pool).trips == 2);
+                // The database recovers and the next probe closes the circuit
+                assert(mkdir(dir, 0700) == 0);
+                usleep(1100000);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                assert(ConnectionPool_getCircuitState(pool) == Circuit_closed);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+                unlink(db);
+                rmdir(dir);
+                FREE(db);
+                FREE(dir);
+                printf("=> Test22: OK\n\n");
+        }
+
+
+        printf("=> Test23: Deferred reset\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_setDeferredReset(pool, true);
+                assert(ConnectionPool_getDeferredReset(pool));
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                assert(con);
+                Connection_setQueryTimeout(con, 3000);
+                assert(Connection_prepareStatement(con, "select 1"));
+                Connection_beginTransaction(con);
+                // Returned at once and reset in the background
+                Connection_close(con);
+                assert(ConnectionPool_active(pool) == 0);
+                con = ConnectionPool_getConnectionWithTimeout(pool, 5000);
+                assert(con);
+                assert(! Connection_isInTransaction(con));
+                assert(Connection_getQueryTimeout(con) == 0);
+                Connection_close(con);
+                // A Connection waiting to be reset is closed when the pool is stopped
+                con = ConnectionPool_getConnectionWithTimeout(pool, 5000);
+                assert(con);
+                Connection_beginTransaction(con);
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test23: OK\n\n");
+
+        printf("=> Test24: Statement cache\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setInitialConnections(pool, 1);
+                ConnectionPool_setMaxConnections(pool, 1);
+                ConnectionPool_setStatementCache(pool, 2, 0);
+                assert(ConnectionPool_getStatementCacheSize(pool) == 2);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                PreparedStatement_T p = Connection_prepareStatement(con, "select 1");
+                ResultSet_T r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                // The open result set is closed when the connection is returned, the statement is kept
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                assert(Connection_prepareStatement(con, "select %d", 1) == p);
+                r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 1);
+                assert(Connection_prepareStatement(con, "select 2"));
+                // The cache is full and statements used in this check-out are not evicted
+                assert(Connection_prepareStatement(con, "select 3"));
+                Connection_close(con);
+                Statistics_T stats = ConnectionPool_getStatistics(pool);
+                assert(stats.statementHits == 1);
+                assert(stats.statementMisses == 3);
+                // In a new check-out the least recently used statement is evicted
+                con = ConnectionPool_getConnection(pool);
+                p = Connection_prepareStatement(con, "select 3");
+                assert(Connection_prepareStatement(con, "select 2"));
+                // A statement already returned in this check-out is not shared, the same SQL is prepared again
+                PreparedStatement_T q = Connection_prepareStatement(con, "select 3");
+                assert(q && q != p);
+                r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                r = PreparedStatement_executeQuery(q);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 3);
+                Connection_close(con);
+                stats = ConnectionPool_getStatistics(pool);
+                assert(stats.statementHits == 2);
+                assert(stats.statementMisses == 5);
+                // The cached statement is returned again in the next check-out
+                con = ConnectionPool_getConnection(pool);
+                assert(Connection_prepareStatement(con, "select 3") == p);
+                Connection_close(con);
+                // Parameters of a cached statement are cleared when the connection is returned
+                con = ConnectionPool_getConnection(pool);
+                p = Connection_prepareStatement(con, "select ?, ?");
+                PreparedStatement_setString(p, 1, "a");
+                PreparedStatement_setString(p, 2, "b");
+                r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 2), "b"));
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                assert(Connection_prepareStatement(con, "select ?, ?") == p);
+                PreparedStatement_setString(p, 1, "c");
+                r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "c"));
+                assert(ResultSet_isnull(r, 2));
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test24: OK\n\n");
+
+        printf("=> Test25: Batch\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_batch;"); ELSE END_TRY;
+                Connection_execute(con, "create table zild_batch(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_batch(id, name) values(?, ?);");
+                char name[32];
+                for (int i = 0; i < 100; i++) {
+                        // Values are copied so the buffer can be reused for each entry
+                        snprintf(name, sizeof(name), "batch %d", i);
+                        PreparedStatement_setInt32(p, 1, i);
+                        PreparedStatement_setString(p, 2, (i % 10) ? name : NULL);
+                        PreparedStatement_addBatch(p);
+                }
+                assert(PreparedStatement_getBatchSize(p) == 100);
+                assert(PreparedStatement_executeBatch(p) == 100);
+                assert(PreparedStatement_getBatchSize(p) == 0);
+                for (int i = 1; i <= 100; i++) {
+                        long long n = PreparedStatement_getBatchRowsChanged(p, i);
+                        assert(n == 1 || n == -1);
+                }
+                ResultSet_T r = Connection_executeQuery(con, "select count(*), count(name) from zild_batch;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 100);
+                assert(ResultSet_getInt(r, 2) == 90);
+                r = Connection_executeQuery(con, "select name from zild_batch where id = 42;");
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "batch 42"));
+                // Rows changed for each entry
+                p = Connection_prepareStatement(con, "update zild_batch set name = ? where id < ?;");
+                PreparedStatement_setString(p, 1, "updated");
+                PreparedStatement_setInt32(p, 2, 10);
+                PreparedStatement_addBatch(p);
+                PreparedStatement_setInt32(p, 2, 0);
+                PreparedStatement_addBatch(p);
+                assert(PreparedStatement_executeBatch(p) == 2);
+                assert(PreparedStatement_getBatchRowsChanged(p, 1) == 10 || PreparedStatement_getBatchRowsChanged(p, 1) == -1);
+                assert(PreparedStatement_getBatchRowsChanged(p, 2) == 0 || PreparedStatement_getBatchRowsChanged(p, 2) == -1);
+                assert(PreparedStatement_executeBatch(p) == 0);
+                TRY
+                {
+                        PreparedStatement_getBatchRowsChanged(p, 1);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                END_TRY;
+                // A failed entry throws and the batch is cleared
+                p = Connection_prepareStatement(con, "insert into zild_batch(id, name) values(?, ?);");
+                PreparedStatement_setInt32(p, 1, 1000);
+                PreparedStatement_addBatch(p);
+                PreparedStatement_setInt32(p, 1, 1);
+                PreparedStatement_addBatch(p);
+                TRY
+                {
+                        PreparedStatement_executeBatch(p);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                {
+                        assert(PreparedStatement_getBatchSize(p) == 0);
+                }
+                END_TRY;
+                if (Str_startsWith(testURL, "sqlite")) {
+                        // An unsigned value above INT64_MAX is stored the same with and without a batch
+                        PreparedStatement_setInt32(p, 1, 2000);
+                        PreparedStatement_setUInt64(p, 2, 18446744073709551615ULL);
+                        PreparedStatement_execute(p);
+                        PreparedStatement_setInt32(p, 1, 2001);
+                        PreparedStatement_addBatch(p);
+                        assert(PreparedStatement_executeBatch(p) == 1);
+                        r = Connection_executeQuery(con, "select name from zild_batch where id >= 2000;");
+                        for (int i = 0; i < 2; i++) {
+                                assert(ResultSet_next(r));
+                                assert(Str_isEqual(ResultSet_getString(r, 1), "18446744073709551615"));
+                        }
+                }
+                Connection_execute(con, "drop table zild_batch;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test25: OK\n\n");
+
+        printf("=> Test26: Batch rewrite\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setBatchRewrite(pool, true);
+                assert(ConnectionPool_getBatchRewrite(pool));
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_batch;"); ELSE END_TRY;
+                Connection_execute(con, "create table zild_batch(id INTEGER PRIMARY KEY, name VARCHAR(255), note VARCHAR(255));");
+                // Quoted text in the VALUES tuple is not a parameter
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_batch(id, name, note) values (?, ?, '(?)');");
+                char name[32];
+                for (int i = 0; i < 5001; i++) {
+                        snprintf(name, sizeof(name), "batch %d", i);
+                        PreparedStatement_setInt32(p, 1, i);
+                        PreparedStatement_setString(p, 2, (i % 10) ? name : NULL);
+                        PreparedStatement_addBatch(p);
+                }
+                assert(PreparedStatement_executeBatch(p) == 5001);
+                for (int i = 1; i <= 5001; i++)
+                        assert(PreparedStatement_getBatchRowsChanged(p, i) == 1);
+                ResultSet_T r = Connection_executeQuery(con, "select count(*), count(name) from zild_batch where note = '(?)';");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 5001);
+                assert(ResultSet_getInt(r, 2) == 4500);
+                r = Connection_executeQuery(con, "select name from zild_batch where id = 4242;");
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "batch 4242"));
+                // The rewritten statements are reused by the next batch
+                for (int i = 0; i < 3; i++) {
+                        PreparedStatement_setInt32(p, 1, 6000 + i);
+                        PreparedStatement_setString(p, 2, "again");
+                        PreparedStatement_addBatch(p);
+                }
+                assert(PreparedStatement_executeBatch(p) == 3);
+                r = Connection_executeQuery(con, "select count(*) from zild_batch where name = 'again';");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 3);
+                // A statement which is not a single-row INSERT is executed entry by entry
+                p = Connection_prepareStatement(con, "update zild_batch set name = ? where id < ?;");
+                PreparedStatement_setString(p, 1, "updated");
+                PreparedStatement_setInt32(p, 2, 10);
+                PreparedStatement_addBatch(p);
+                PreparedStatement_setInt32(p, 2, 0);
+                PreparedStatement_addBatch(p);
+                assert(PreparedStatement_executeBatch(p) == 2);
+                assert(PreparedStatement_getBatchRowsChanged(p, 1) == 10 || PreparedStatement_getBatchRowsChanged(p, 1) == -1);
+                assert(PreparedStatement_getBatchRowsChanged(p, 2) == 0 || PreparedStatement_getBatchRowsChanged(p, 2) == -1);
+                // A failed rewritten batch throws and the batch is cleared
+                p = Connection_prepareStatement(con, "insert into zild_batch(id, name, note) values (?, ?, '(?)');");
+                PreparedStatement_setInt32(p, 1, 7000);
+                PreparedStatement_addBatch(p);
+                PreparedStatement_setInt32(p, 1, 1);
+                PreparedStatement_addBatch(p);
+                TRY
+                {
+                        PreparedStatement_executeBatch(p);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                {
+                        assert(PreparedStatement_getBatchSize(p) == 0);
+                }
+                END_TRY;
+                Connection_execute(con, "drop table zild_batch;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test26: OK\n\n");
+
+        printf("=> Test27: Pipeline\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_pipeline;"); ELSE END_TRY;
+                Connection_execute(con, "create table zild_pipeline(id INTEGER PRIMARY KEY, name VARCHAR(255));");
+                // Does nothing if not in pipeline mode
+                Connection_endPipeline(con);
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_pipeline(id, name) values(?, ?);");
+                Connection_beginPipeline(con);
+                Connection_beginPipeline(con);
+                Connection_beginTransaction(con);
+                for (int i = 0; i < 100; i++) {
+                        PreparedStatement_setInt32(p, 1, i);
+                        PreparedStatement_setString(p, 2, "pipeline");
+                        PreparedStatement_execute(p);
+                }
+                Connection_execute(con, "update zild_pipeline set name = 'updated' where id < 10;");
+                // A query reads the results of the statements queued before it
+                ResultSet_T r = Connection_executeQuery(con, "select count(*) from zild_pipeline where name = 'pipeline';");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 90);
+                Connection_execute(con, "delete from zild_pipeline where id >= 50;");
+                Connection_commit(con);
+                Connection_endPipeline(con);
+                r = Connection_executeQuery(con, "select count(*) from zild_pipeline;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 50);
+                // A failed statement is thrown at the latest by Connection_endPipeline()
+                Connection_beginPipeline(con);
+                TRY
+                {
+                        Connection_execute(con, "insert into zild_pipeline(id, name) values(1, 'duplicate');");
+                        Connection_endPipeline(con);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                {
+                        Connection_endPipeline(con);
+                }
+                END_TRY;
+                r = Connection_executeQuery(con, "select count(*) from zild_pipeline;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 50);
+                // Queued statements are executed when the Connection is returned
+                Connection_beginPipeline(con);
+                Connection_execute(con, "delete from zild_pipeline;");
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                r = Connection_executeQuery(con, "select count(*) from zild_pipeline;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 0);
+                Connection_execute(con, "drop table zild_pipeline;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test27: OK\n\n");
+
+        printf("=> Test28: Bulk load\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_t;"); ELSE END_TRY;
+                Connection_execute(con, "%s", schema);
+                // Oracle's image column is a CLOB
+                bool blobs = ! Str_startsWith(testURL, "oracle");
+                char name[64];
+                unsigned char image[6] = {0, '\t', '\\', '\n', 0xff, 0};
+                BulkLoader_T l = Connection_bulkLoad(con, "zild_t", blobs ? "name, percent, image" : "name, percent");
+                for (int i = 0; i < 25000; i++) {
+                        // Delimiter and escape characters must be loaded as-is
+                        snprintf(name, sizeof(name), (i % 7) ? "bulk %d" : "tab\there\nnew\\line %d", i);
+                        BulkLoader_setString(l, 1, (i % 10) ? name : NULL);
+                        BulkLoader_setDouble(l, 2, i % 2 ? 0.5 : 2.25);
+                        if (blobs && i == 7) {
+                                image[5] = (unsigned char)i;
+                                BulkLoader_setBlob(l, 3, image, sizeof(image));
+                        }
+                        BulkLoader_appendRow(l);
+                }
+                assert(BulkLoader_getRows(l) == 25000);
+                TRY
+                {
+                        BulkLoader_setString(l, 0, "out of range");
+                        assert(false);
+                }
+                CATCH(SQLException)
+                END_TRY;
+                assert(BulkLoader_finish(l) == 25000);
+                TRY
+                {
+                        BulkLoader_appendRow(l);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                END_TRY;
+                ResultSet_T r = Connection_executeQuery(con, "select count(*), count(name), count(image) from zild_t;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 25000);
+                assert(ResultSet_getInt(r, 2) == 22500);
+                assert(ResultSet_getInt(r, 3) == (blobs ? 1 : 0));
+                r = Connection_executeQuery(con, "select name, percent, image from zild_t where name like 'tab%%7';");
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "tab\there\nnew\\line 7"));
+                assert(ResultSet_getDouble(r, 2) == 0.5);
+                if (blobs) {
+                        int size;
+                        const void *blob = ResultSet_getBlob(r, 3, &size);
+                        assert(size == sizeof(image) && memcmp(blob, image, size) == 0);
+                }
+                // A load in the caller's transaction is not committed by the BulkLoader
+                Connection_beginTransaction(con);
+                l = Connection_bulkLoad(con, "zild_t", "name");
+                BulkLoader_setString(l, 1, "rolled back");
+                BulkLoader_appendRow(l);
+                assert(BulkLoader_finish(l) == 1);
+                Connection_rollback(con);
+                // A load which is not finished is rolled back
+                l = Connection_bulkLoad(con, "zild_t", "name");
+                BulkLoader_setString(l, 1, "not finished");
+                BulkLoader_appendRow(l);
+                Connection_close(con);
+                con = ConnectionPool_getConnection(pool);
+                r = Connection_executeQuery(con, "select count(*) from zild_t;");
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == 25000);
+                Connection_execute(con, "drop table zild_t;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test28: OK\n\n");
+
+        printf("=> Test29: Binary results\n");
+        if (Str_startsWith(testURL, "postgres")) {
+                char *binaryURL = Str_cat("%s%cbinary-result=true", testURL, strchr(testURL, '?') ? '&' : '?');
+                url = URL_new(binaryURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                const char *columns = "42::int2, -7::int4, 9000000000::int8, 0.1::float8, 1.5::float4, true, 'text'::varchar, 12345.678::numeric, "
+                                      "'\\x00ff'::bytea, '2024-02-29 12:34:56.5'::timestamp, 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid, null::int4";
+                // Results are in text format the first time a statement is executed and from the second time in binary
+                // format, except for the statement with a date column which can't be read in binary
+                for (int binary = 1; binary >= 0; binary--) {
+                        PreparedStatement_T p = Connection_prepareStatement(con, "select %s%s where ? > 0;", columns, binary ? "" : ", current_date");
+                        for (int i = 0; i < 2; i++) {
+                                PreparedStatement_setInt32(p, 1, 1);
+                                ResultSet_T r = PreparedStatement_executeQuery(p);
+                                assert(ResultSet_next(r));
+                                assert(ResultSet_getInt(r, 1) == 42);
+                                assert(Str_isEqual(ResultSet_getString(r, 2), "-7"));
+                                assert(ResultSet_getLLong(r, 3) == 9000000000LL);
+                                assert(Str_isEqual(ResultSet_getString(r, 4), "0.1"));
+                                assert(ResultSet_getDouble(r, 4) == 0.1);
+                                assert(ResultSet_getDouble(r, 5) == 1.5);
+                                assert(Str_isEqual(ResultSet_getString(r, 6), "t"));
+                                assert(Str_isEqual(ResultSet_getString(r, 7), "text"));
+                                assert(Str_isEqual(ResultSet_getString(r, 8), "12345.678"));
+                                int size;
+                                const unsigned char *blob = ResultSet_getBlob(r, 9, &size);
+                                assert(size == 2 && blob[0] == 0 && blob[1] == 0xff);
+                                assert(Str_isEqual(ResultSet_getString(r, 10), "2024-02-29 12:34:56.5"));
+                                assert(ResultSet_getTimestamp(r, 10) == 1709210096);
+                                assert(Str_isEqual(ResultSet_getString(r, 11), "a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11"));
+                                assert(ResultSet_isnull(r, 12) && ResultSet_getInt(r, 12) == 0);
+                                assert(! ResultSet_next(r));
+                        }
+                }
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+                FREE(binaryURL);
+        }
+        printf("=> Test29: OK\n\n");
+
+        printf("=> Test30: Typed parameters\n");
+        if (Str_startsWith(testURL, "postgres")) {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_typed;"); ELSE END_TRY;
+                Connection_execute(con, "create table zild_typed(i2 int2, i4 int4, i8 int8, f4 float4, f8 float8, ts timestamp, tz timestamptz, n numeric, t text);");
+                // Values are sent as text the first time and in binary from the second time the statement is executed
+                PreparedStatement_T p = Connection_prepareStatement(con, "insert into zild_typed values(?, ?, ?, ?, ?, ?, ?, ?, ?);");
+                for (int i = 1; i <= 3; i++) {
+                        PreparedStatement_setInt16(p, 1, -i);
+                        PreparedStatement_setInt32(p, 2, i * 100000);
+                        PreparedStatement_setInt64(p, 3, i * 5000000000LL);
+                        PreparedStatement_setDouble(p, 4, i + 0.5);
+                        PreparedStatement_setDouble(p, 5, i / 3.0);
+                        PreparedStatement_setTimestamp(p, 6, 1387066378 + i);
+                        PreparedStatement_setTimestamp(p, 7, 1387066378 + i);
+                        PreparedStatement_setUInt64(p, 8, 18446744073709551615ULL);
+                        PreparedStatement_setInt32(p, 9, i);
+                        PreparedStatement_execute(p);
+                }
+                p = Connection_prepareStatement(con, "select i2, i4, i8, f4, f8, ts, tz, n, t from zild_typed where i4 = ?;");
+                for (int i = 1; i <= 3; i++) {
+                        PreparedStatement_setInt64(p, 1, i * 100000);
+                        ResultSet_T r = PreparedStatement_executeQuery(p);
+                        assert(ResultSet_next(r));
+                        assert(ResultSet_getInt(r, 1) == -i);
+                        assert(ResultSet_getLLong(r, 3) == i * 5000000000LL);
+                        assert(ResultSet_getDouble(r, 4) == i + 0.5);
+                        assert(ResultSet_getTimestamp(r, 6) == 1387066378 + i);
+                        assert(ResultSet_getTimestamp(r, 7) == 1387066378 + i);
+                        assert(Str_isEqual(ResultSet_getString(r, 8), "18446744073709551615"));
+                        assert(ResultSet_getInt(r, 9) == i);
+                        assert(! ResultSet_next(r));
+                }
+                // A value out of range of the parameter type is sent as text and rejected by the server
+                PreparedStatement_setInt64(p, 1, 5000000000LL);
+                TRY
+                {
+                        PreparedStatement_executeQuery(p);
+                        assert(false);
+                }
+                CATCH(SQLException)
+                END_TRY;
+                Connection_execute(con, "drop table zild_typed;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test30: OK\n\n");
+
+        printf("=> Test31: Native column types\n");
+        if (Str_startsWith(testURL, "mysql")) {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                TRY Connection_execute(con, "drop table zild_native;"); ELSE END_TRY;
+                TRY Connection_execute(con, "drop table zild_text;"); ELSE END_TRY;
+                Connection_execute(con, "create table zild_native(i int, u bigint unsigned, z int(4) zerofill, f float, d double, dt date, t time, ts datetime(3), s varchar(16));");
+                Connection_execute(con, "insert into zild_native values(-42, 18446744073709551615, 7, 1.5, 0.1, '2013-12-14', '23:59:58', '2013-12-15 00:12:58.125', 'text');");
+                Connection_execute(con, "insert into zild_native values(null, null, null, null, null, null, null, null, null);");
+                PreparedStatement_T p = Connection_prepareStatement(con, "select i, u, z, f, d, dt, t, ts, s from zild_native order by i desc;");
+                ResultSet_T r = PreparedStatement_executeQuery(p);
+                assert(ResultSet_next(r));
+                assert(ResultSet_getInt(r, 1) == -42);
+                assert(Str_isEqual(ResultSet_getString(r, 1), "-42"));
+                assert(ResultSet_getDouble(r, 2) == 18446744073709551615.0);
+                assert(Str_isEqual(ResultSet_getString(r, 2), "18446744073709551615"));
+                assert(Str_isEqual(ResultSet_getString(r, 3), "0007"));
+                assert(ResultSet_getDouble(r, 4) == 1.5);
+                assert(Str_isEqual(ResultSet_getString(r, 4), "1.5"));
+                assert(ResultSet_getDouble(r, 5) == 0.1);
+                assert(Str_isEqual(ResultSet_getString(r, 5), "0.1"));
+                assert(Str_isEqual(ResultSet_getString(r, 6), "2013-12-14"));
+                assert(ResultSet_getTimestamp(r, 6) == 1386979200);
+                struct tm tm = ResultSet_getDateTime(r, 7);
+                assert(tm.tm_hour == 23 && tm.tm_min == 59 && tm.tm_sec == 58);
+                assert(Str_isEqual(ResultSet_getString(r, 7), "23:59:58"));
+                assert(Str_isEqual(ResultSet_getString(r, 8), "2013-12-15 00:12:58.125"));
+                assert(ResultSet_getTimestamp(r, 8) == 1387066378);
+                tm = ResultSet_getDateTime(r, 8);
+                assert(tm.tm_year == 2013 && tm.tm_mon == 11 && tm.tm_mday == 15);
+                assert(ResultSet_getColumnSize(r, 8) == 23);
+                assert(Str_isEqual(ResultSet_getString(r, 9), "text"));
+                assert(ResultSet_next(r));
+                for (int i = 1; i <= 9; i++) {
+                        assert(ResultSet_isnull(r, i));
+                        assert(ResultSet_getString(r, i) == NULL);
+                }
+                assert(ResultSet_getLLong(r, 1) == 0);
+                assert(ResultSet_getTimestamp(r, 8) == 0);
+                assert(! ResultSet_next(r));
+                r = Connection_executeQuery(con, "select 10e0, 1500e0, 0.25e0, 1e20, -1.5e-7;");
+                assert(ResultSet_next(r));
+                assert(Str_isEqual(ResultSet_getString(r, 1), "10"));
+                assert(Str_isEqual(ResultSet_getString(r, 2), "1500"));
+                assert(Str_isEqual(ResultSet_getString(r, 3), "0.25"));
+                assert(Str_isEqual(ResultSet_getString(r, 4), "1e20"));
+                assert(Str_isEqual(ResultSet_getString(r, 5), "-1.5e-7"));
+                // Text values larger than the column buffer grow the buffer
+                Connection_execute(con, "create table zild_text(n int, t text);");
+                Connection_execute(con, "insert into zild_text values(1, repeat('a', 100)), (2, repeat('b', 20000)), (3, repeat('c', 40000)), (4, 'd');");
+                r = Connection_executeQuery(con, "select n, t from zild_text order by n;");
+                for (int n = 1; ResultSet_next(r); n++) {
+                        const char *t = ResultSet_getString(r, 2);
+                        long size = n == 4 ? 1 : n == 1 ? 100 : n == 2 ? 20000 : 40000;
+                        assert(ResultSet_getColumnSize(r, 2) == size);
+                        assert(strlen(t) == size && t[0] == 'a' + n - 1 && t[size - 1] == 'a' + n - 1);
+                }
+                Connection_execute(con, "drop table zild_text;");
+                Connection_execute(con, "drop table zild_native;");
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test31: OK\n\n");
+
+        printf("=> Test32: Validation\n");
+        {
+                url = URL_new(testURL);
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                assert(ConnectionPool_getValidation(pool) == Validation_idle);
+                // Connections idle for less than the threshold are handed out without a ping, others are pinged
+                ConnectionPool_setValidation(pool, Validation_idle, 100);
+                assert(ConnectionPool_getValidation(pool) == Validation_idle);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_start(pool);
+                Connection_T con = ConnectionPool_getConnection(pool);
+                Connection_close(con);
+                assert(ConnectionPool_getConnection(pool) == con);
+                Connection_close(con);
+                Time_usleep(200000);
+                assert(ConnectionPool_getConnection(pool) == con);
+                Connection_close(con);
+                assert(ConnectionPool_size(pool) == 2);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                // The reaper pings idle connections and keeps those alive in place
+                pool = ConnectionPool_new(url);
+                assert(pool);
+                ConnectionPool_setAbortHandler(pool, TabortHandler);
+                ConnectionPool_setValidation(pool, Validation_background, 0);
+                assert(ConnectionPool_getValidation(pool) == Validation_background);
+                ConnectionPool_setInitialConnections(pool, 2);
+                ConnectionPool_setReaper(pool, 1);
+                ConnectionPool_start(pool);
+                con = ConnectionPool_getConnection(pool);
+                Connection_close(con);
+                Time_usleep(2500000);
+                assert(ConnectionPool_size(pool) == 2);
+                assert(ConnectionPool_getStatistics(pool).reaped == 0);
+                assert(ConnectionPool_getConnection(pool) == con);
+                assert(Connection_ping(con));
+                Connection_close(con);
+                ConnectionPool_stop(pool);
+                ConnectionPool_free(&pool);
+                assert(pool==NULL);
+                URL_free(&url);
+        }
+        printf("=> Test32: OK\n\n");
 
         printf("============> Connection Pool Tests: OK\n\n");
 }